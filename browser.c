@@ -0,0 +1,572 @@
+#include "browser.h"
+#include "utils.h"
+#include "keyboards.h"
+#include "idle.h"
+#include "text.h"
+#include "library.h"
+
+static struct TagNode *
+node_push(struct TagNode *node, int *size, const char *name)
+{
+  struct TagNode *child;
+
+  if(node->nchild == *size)
+	{
+	  *size = *size ? *size * 2 : 64;
+	  node->child = (struct TagNode*)
+		realloc(node->child, *size * sizeof(struct TagNode));
+	}
+
+  child = node->child + node->nchild++;
+  memset(child, 0, sizeof(*child));
+  child->name = strdup(name);
+
+  return child;
+}
+
+static void
+node_clear(struct TagNode *node)
+{
+  int i;
+
+  for(i = 0; i < node->nchild; i++)
+	{
+	  node_clear(node->child + i);
+	  free(node->child[i].name);
+	  free(node->child[i].uri);
+	}
+
+  free(node->child);
+  node->child = NULL;
+  node->nchild = 0;
+  node->fetched = 0;
+}
+
+/* a server error leaves the level empty, it's asked again only
+   after the database changes. anything else ends the session */
+static void
+fetch_finish(void)
+{
+  if(mpd_response_finish(conn))
+	return;
+
+  if(mpd_connection_get_error(conn) != MPD_ERROR_SERVER)
+	printErrorAndExit(conn);
+  mpd_connection_clear_error(conn);
+}
+
+// the constraints down to the node at level, the root has none
+static void
+add_constraints(int level)
+{
+  if(level >= LEVEL_ALBUM)
+	mpd_search_add_tag_constraint(conn, MPD_OPERATOR_DEFAULT, MPD_TAG_ARTIST,
+								  browser->path[LEVEL_ALBUM]->name);
+  if(level >= LEVEL_SONG)
+	mpd_search_add_tag_constraint(conn, MPD_OPERATOR_DEFAULT, MPD_TAG_ALBUM,
+								  browser->path[LEVEL_SONG]->name);
+}
+
+/* the values of tag under the node at level, with their songs
+   counted by mpd: "count group <tag>" gives a value then its
+   "songs" and "playtime", all in one response */
+static void
+fetch_groups(struct TagNode *node, int level, enum mpd_tag_type tag)
+{
+  const char *tag_name = mpd_tag_name(tag);
+  struct TagNode *child = NULL;
+  struct mpd_pair *pair;
+  int size = 0;
+
+  if(!mpd_count_db_songs(conn))
+	printErrorAndExit(conn);
+  add_constraints(level);
+  mpd_search_add_group_tag(conn, tag);
+  if(!mpd_search_commit(conn))
+	printErrorAndExit(conn);
+
+  while((pair = mpd_recv_pair(conn)) != NULL)
+	{
+	  if(strcmp(pair->name, tag_name) == 0)
+		child = node_push(node, &size, pair->value);
+	  else if(child && strcmp(pair->name, "songs") == 0)
+		child->songs = strtoul(pair->value, NULL, 10);
+	  else if(child && strcmp(pair->name, "playtime") == 0)
+		child->duration = strtoul(pair->value, NULL, 10);
+	  mpd_return_pair(conn, pair);
+	}
+
+  fetch_finish();
+}
+
+static int
+by_name(const void *a, const void *b)
+{
+  return strcmp(((const struct TagNode*) a)->name,
+				((const struct TagNode*) b)->name);
+}
+
+/* the same as fetch_groups() but counted from the library's
+   snapshot, no round trip at all. its strings are kept once, a
+   value is told by its offset */
+static void
+snapshot_groups(struct TagNode *node, int level)
+{
+  const char *artist_name = level == LEVEL_ALBUM ?
+	browser->path[LEVEL_ALBUM]->name : NULL;
+  const struct LibraryRecord *rec;
+  struct { uint32_t value; int child; } *slot;
+  uint32_t value, artist = 0;
+  int i, s, nslot, size = 0, found = 0;
+  struct TagNode *child;
+
+  for(nslot = 64; nslot < 2 * library->count; nslot *= 2);
+  slot = malloc(nslot * sizeof(*slot));
+  for(s = 0; s < nslot; s++)
+	slot[s].child = -1;
+
+  for(i = 0; i < library->count; i++)
+	{
+	  rec = library->record + i;
+
+	  if(artist_name) // the songs of the artist opened only
+		{
+		  if(!found && strcmp(library_string(library, rec->artist),
+							  artist_name) == 0)
+			found = 1, artist = rec->artist;
+		  if(!found || rec->artist != artist)
+			continue;
+		  value = rec->album;
+		}
+	  else
+		value = rec->artist;
+
+	  s = (value * 2654435761u) & (nslot - 1);
+	  while(slot[s].child >= 0 && slot[s].value != value)
+		s = (s + 1) & (nslot - 1);
+
+	  if(slot[s].child < 0)
+		{
+		  slot[s].value = value;
+		  slot[s].child = node->nchild;
+		  node_push(node, &size, library_string(library, value));
+		}
+
+	  child = node->child + slot[s].child;
+	  child->songs++;
+	  child->duration += rec->duration;
+	}
+
+  free(slot);
+
+  qsort(node->child, node->nchild, sizeof(struct TagNode), by_name);
+}
+
+static int
+by_track(const void *a, const void *b)
+{
+  const struct TagNode *x = a, *y = b;
+
+  if(x->track != y->track)
+	return x->track < y->track ? -1 : 1;
+  return strcmp(x->uri, y->uri);
+}
+
+// the songs of the album at the song level, in track order
+static void
+fetch_songs(struct TagNode *node)
+{
+  const struct mpd_song *song;
+  struct mpd_entity *entity;
+  struct TagNode *child;
+  const char *track;
+  int size = 0;
+
+  if(!mpd_search_db_songs(conn, true))
+	printErrorAndExit(conn);
+  add_constraints(LEVEL_SONG);
+  if(!mpd_search_commit(conn))
+	printErrorAndExit(conn);
+
+  while((entity = mpd_recv_entity(conn)) != NULL)
+	{
+	  if(mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG)
+		{
+		  song = mpd_entity_get_song(entity);
+		  child = node_push(node, &size, get_song_tag(song, MPD_TAG_TITLE));
+		  child->uri = strdup(mpd_song_get_uri(song));
+		  child->songs = 1;
+		  child->duration = mpd_song_get_duration(song);
+		  track = mpd_song_get_tag(song, MPD_TAG_TRACK, 0);
+		  child->track = track && atoi(track) > 0 ? atoi(track) : 0;
+		}
+	  mpd_entity_free(entity);
+	}
+
+  fetch_finish();
+
+  qsort(node->child, node->nchild, sizeof(struct TagNode), by_track);
+}
+
+/* the level shown is asked of mpd, if it isn't known yet. artists
+   and albums are counted from the library's snapshot when it's up
+   to date. without the idle connection a change can't be heard of,
+   then it's asked again every time it's shown */
+static void
+browser_fetch(void)
+{
+  struct TagNode *node = browser->path[browser->level];
+
+  if(node->fetched && !idle_alive())
+	node_clear(node);
+
+  if(!node->fetched)
+	{
+	  if(browser->level != LEVEL_SONG && library_current())
+		snapshot_groups(node, browser->level);
+	  else if(browser->level == LEVEL_ARTIST)
+		fetch_groups(node, LEVEL_ARTIST, MPD_TAG_ARTIST);
+	  else if(browser->level == LEVEL_ALBUM)
+		fetch_groups(node, LEVEL_ALBUM, MPD_TAG_ALBUM);
+	  else
+		fetch_songs(node);
+	  node->fetched = 1;
+	}
+
+  browser->length = node->nchild;
+}
+
+static int
+find_child(const struct TagNode *node, const char *name)
+{
+  int i;
+
+  for(i = 0; i < node->nchild; i++)
+	if(strcmp(node->child[i].name, name) == 0)
+	  return i;
+
+  return -1;
+}
+
+/* the database changed, all that's known is dropped. the artist
+   and the album opened are opened again if they're still there */
+static void
+browser_reload(void)
+{
+  char names[BROWSE_LEVELS][512];
+  int i, id, level = browser->level;
+
+  for(i = 1; i <= level; i++)
+	snprintf(names[i], sizeof(names[i]), "%s", browser->path[i]->name);
+
+  node_clear(&browser->root);
+  browser->level = LEVEL_ARTIST;
+  browser_fetch();
+
+  for(i = 1; i <= level; i++)
+	{
+	  if((id = find_child(browser->path[i - 1], names[i])) < 0)
+		break;
+
+	  browser->curs_history[i - 1] = id + 1;
+	  browser->path[i] = browser->path[i - 1]->child + id;
+	  browser->level = i;
+	  browser_fetch();
+	}
+
+  if(browser->level != level)
+	browser->cursor = browser->curs_history[browser->level];
+  browser->begin = 1;
+  browser_scroll_to(browser->cursor);
+  browser->stale = 0;
+}
+
+void
+browser_update_checking(void)
+{
+  if(browser->stale)
+	{
+	  browser_reload();
+	  browser->update_signal = 0;
+	  signal_all_wins();
+	}
+  else if(browser->update_signal)
+	{
+	  browser_fetch();
+	  browser->update_signal = 0;
+	  signal_all_wins();
+	}
+}
+
+static void
+browser_on_database(enum mpd_idle events)
+{
+  browser->stale = 1;
+}
+
+static void
+format_duration(char *buff, int size, unsigned seconds)
+{
+  if(seconds >= 3600)
+	snprintf(buff, size, "%u:%02u:%02u",
+			 seconds / 3600, seconds / 60 % 60, seconds % 60);
+  else
+	snprintf(buff, size, "%u:%02u", seconds / 60, seconds % 60);
+}
+
+/* the name cut to what's left of the row by its count, which
+   goes to the right edge */
+static void
+format_row(char *buff, int size, const struct TagNode *node, int cols)
+{
+  char right[32], name[512], fit[512];
+  int w, rlen;
+
+  if(node->uri)
+	format_duration(right, sizeof(right), node->duration);
+  else
+	snprintf(right, sizeof(right), "%u", node->songs);
+
+  if(node->uri && node->track)
+	snprintf(name, sizeof(name), "%02d %s", node->track, node->name);
+  else
+	snprintf(name, sizeof(name), "%s", *node->name ? node->name : "[unknown]");
+
+  rlen = strlen(right);
+  w = utf8_fit(fit, sizeof(fit), name, cols - rlen - 1);
+  snprintf(buff, size, "%s%*s%s", fit, cols - rlen - w, "", right);
+}
+
+void
+browser_redraw_screen(void)
+{
+  int i, height = wchain[LIBRARY].win->_maxy + 1;
+  WINDOW *win = specific_win(LIBRARY);
+  const int cols = wchain[LIBRARY].win->_maxx - 6;
+  struct TagNode *node = browser->path[browser->level];
+  char buff[1024];
+  int line = 0;
+
+  if(cols <= 8)
+	return;
+
+  for(i = browser->begin - 1; i < browser->begin
+		+ height - 1 && i < browser->length; i++)
+	{
+	  format_row(buff, sizeof(buff), node->child + i, cols);
+
+	  if(i + 1 == browser->cursor)
+		print_list_item(win, line++, 2, i + 1, buff, NULL);
+	  else
+		print_list_item(win, line++, 0, i + 1, buff, NULL);
+	}
+}
+
+void
+browser_helper(void)
+{
+  WINDOW *win = specific_win(LIBHELPER);
+  const char *labels[BROWSE_LEVELS] = {"Artists", "Albums", "Songs"};
+  char buff[64];
+  int i;
+
+  wmove(win, 2, 0);
+  for(i = 1; i <= browser->level; i++)
+	{
+	  utf8_fit(buff, sizeof(buff), *browser->path[i]->name ?
+			   browser->path[i]->name : "[unknown]", 24);
+	  wprintw(win, "   %s\n", buff);
+	}
+  wprintw(win, "   %s: %i\n", labels[browser->level], browser->length);
+
+  wprintw(win,  "\n\
+   <Enter> Open\n\
+   <BS>\t  Back\n\
+  ___________");
+  color_print(win, 6, "\n\n\
+   [a]\t  Append to Current\n\
+   [r]\t  Replace Current");
+  wprintw(win, "\n\n\
+   [c]\t  Clear Current");
+
+  box(win, ':', ' ');
+
+  wmove(win, 0, 1);
+  color_print(win, 3, " Library: ");
+}
+
+void
+browser_enter(void)
+{
+  struct TagNode *node = browser->path[browser->level];
+
+  if(browser->level == LEVEL_SONG
+	 || browser->cursor < 1 || browser->cursor > browser->length)
+	return;
+
+  browser->curs_history[browser->level] = browser->cursor;
+  browser->path[++browser->level] = node->child + browser->cursor - 1;
+
+  browser_fetch();
+  browser->begin = 1;
+  browser_scroll_to(1);
+  signal_all_wins();
+}
+
+// returns 1 if it's at the artists already
+int
+browser_exit(void)
+{
+  if(browser->level == LEVEL_ARTIST)
+	return 1;
+
+  browser->level--;
+  browser_fetch();
+  browser->begin = 1;
+  browser_scroll_to(browser->curs_history[browser->level]);
+  signal_all_wins();
+
+  return 0;
+}
+
+/* the songs under the cursor are added by "findadd" on the same
+   constraints they were listed by, a song by its uri */
+static const char *
+add_cursor(void)
+{
+  struct TagNode *node;
+  int level = browser->level;
+
+  if(browser->cursor < 1 || browser->cursor > browser->length)
+	return NULL;
+
+  node = browser->path[level]->child + browser->cursor - 1;
+  if(level == LEVEL_SONG)
+	{
+	  if(!mpd_run_add(conn, node->uri))
+		fetch_finish();
+	  return node->name;
+	}
+
+  if(!mpd_search_add_db_songs(conn, true))
+	printErrorAndExit(conn);
+  add_constraints(level);
+  mpd_search_add_tag_constraint(conn, MPD_OPERATOR_DEFAULT,
+								level == LEVEL_ARTIST ? MPD_TAG_ARTIST
+								: MPD_TAG_ALBUM, node->name);
+  if(!mpd_search_commit(conn))
+	printErrorAndExit(conn);
+  fetch_finish();
+
+  return node->name;
+}
+
+void
+browser_append(void)
+{
+  const char *name = add_cursor();
+  char message[512];
+
+  if(name == NULL)
+	return;
+
+  snprintf(message, sizeof(message), "\"%s\" Has Been Appended.", name);
+  popup_simple_dialog(message);
+}
+
+void
+browser_replace(void)
+{
+  const char *name;
+  char message[512];
+
+  if(browser->cursor < 1 || browser->cursor > browser->length)
+	return;
+
+  int choice =
+	popup_confirm_dialog("Replacing Confirm:", 0);
+
+  if(!choice) // action canceled
+	return;
+
+  mpd_run_clear(conn);
+  name = add_cursor();
+
+  snprintf(message, sizeof(message), "Replace With \"%s\".", name);
+  popup_simple_dialog(message);
+}
+
+struct Browser *browser_setup(void)
+{
+  struct Browser *brw =
+	(struct Browser*) calloc(1, sizeof(struct Browser));
+
+  brw->path[0] = &brw->root;
+  brw->level = LEVEL_ARTIST;
+  brw->update_signal = 1; // asked of mpd when it's first shown
+  brw->begin = 1;
+  brw->cursor = 1;
+
+  // window mode setup
+  brw->wmode.size = 5;
+  brw->wmode.wins = (struct WindowUnit**)
+	malloc(brw->wmode.size * sizeof(struct WindowUnit*));
+  brw->wmode.wins[0] = &wchain[LIBHELPER];
+  brw->wmode.wins[1] = &wchain[EXTRA_INFO];
+  brw->wmode.wins[2] = &wchain[LIBRARY];
+  brw->wmode.wins[3] = &wchain[SIMPLE_PROC_BAR];
+  brw->wmode.wins[4] = &wchain[BASIC_INFO];
+  brw->wmode.listen_keyboard = &browser_keymap;
+
+  idle_listen(MPD_IDLE_DATABASE, browser_on_database);
+
+  return brw;
+}
+
+void browser_free(struct Browser *brw)
+{
+  node_clear(&brw->root);
+  free(brw->wmode.wins);
+  free(brw);
+}
+
+void
+browser_scroll_to(int line)
+{
+  int height = wchain[LIBRARY].win->_maxy + 1;
+  browser->cursor = 0;
+  scroll_line_shift_style(&browser->cursor, &browser->begin,
+						  browser->length, height, line);
+}
+
+void
+browser_scroll_down_line(void)
+{
+  int height = wchain[LIBRARY].win->_maxy + 1;
+  scroll_line_shift_style(&browser->cursor, &browser->begin,
+						  browser->length, height, +1);
+}
+
+void
+browser_scroll_up_line(void)
+{
+  int height = wchain[LIBRARY].win->_maxy + 1;
+  scroll_line_shift_style(&browser->cursor, &browser->begin,
+						  browser->length, height, -1);
+}
+
+void
+browser_scroll_up_page(void)
+{
+  int height = wchain[LIBRARY].win->_maxy + 1;
+  scroll_line_shift_style(&browser->cursor, &browser->begin,
+						  browser->length, height, -15);
+}
+
+void
+browser_scroll_down_page(void)
+{
+  int height = wchain[LIBRARY].win->_maxy + 1;
+  scroll_line_shift_style(&browser->cursor, &browser->begin,
+						  browser->length, height, +15);
+}
@@ -0,0 +1,75 @@
+#include "global.h"
+#include "windows.h"
+
+#ifndef RFVTGBYHNUJMIKOLPQAZ
+#define RFVTGBYHNUJMIKOLPQAZ
+
+#define BROWSE_LEVELS 3 // artists, albums, songs
+
+// where the cursor is in the tag hierarchy
+enum browse_level
+  {
+	LEVEL_ARTIST,
+	LEVEL_ALBUM,
+	LEVEL_SONG
+  };
+
+/* an artist, an album of one or a song of an album. the names
+ * under a node are asked of mpd the first time it's opened and
+ * kept until its database changes */
+struct TagNode
+{
+  char *name;   // the tag's value, the title for a song
+  char *uri;    // a song's, NULL for the others
+
+  unsigned songs;    // under it, as counted by mpd
+  unsigned duration; // seconds, of them all
+  int track;         // a song's, 0 if it has none
+
+  int fetched; // children asked of mpd already
+  int nchild;
+  struct TagNode *child;
+};
+
+struct Browser
+{
+  struct TagNode root; // its children are the artists
+
+  // the nodes opened, path[0] is the root, path[level] is shown
+  struct TagNode *path[BROWSE_LEVELS];
+  int level; // enum browse_level
+
+  int stale; // mpd's database changed, see browser_reload()
+
+  struct WinMode wmode; // windows in this mode
+
+  int update_signal;
+
+  int length;
+  int begin;
+  int cursor;
+
+  int curs_history[BROWSE_LEVELS];
+};
+
+struct Browser *browser;
+
+void browser_redraw_screen(void);
+void browser_update_checking(void);
+void browser_helper(void);
+void browser_enter(void);
+int  browser_exit(void);
+void browser_append(void);
+void browser_replace(void);
+
+struct Browser *browser_setup(void);
+void browser_free(struct Browser *brw);
+
+// list manipulation commands
+void browser_scroll_to(int line);
+void browser_scroll_down_line(void);
+void browser_scroll_up_line(void);
+void browser_scroll_up_page(void);
+void browser_scroll_down_page(void);
+
+#endif
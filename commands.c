@@ -5,6 +5,7 @@
 #include "songs.h"
 #include "directory.h"
 #include "playlists.h"
+#include "browser.h"
 #include "visualizer.h"
 
 void
@@ -215,25 +216,36 @@ switch_to_playlist_menu(void)
   crt_menu = 2;
 }
 
+void
+switch_to_library_menu(void)
+{
+  clean_screen();
+
+  being_mode_update(&browser->wmode);
+  browser->update_signal = 1; // it may be stale, see browser_fetch()
+
+  crt_menu = 4;
+}
 
-void (*menu_list[4])(void) = {
+void (*menu_list[5])(void) = {
   &switch_to_main_menu,
   &switch_to_songlist_menu,
   &switch_to_playlist_menu,
-  &switch_to_directory_menu
+  &switch_to_directory_menu,
+  &switch_to_library_menu
 };
 
 void
 switch_to_next_menu(void)
 {
-  int next_menu = (crt_menu+1) % 4;
+  int next_menu = (crt_menu+1) % 5;
   menu_list[next_menu]();
 }
 
 void
 switch_to_prev_menu(void)
 {
-  int next_menu = (crt_menu+3) % 4;
+  int next_menu = (crt_menu+4) % 5;
   menu_list[next_menu]();
 }
 
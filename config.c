@@ -0,0 +1,120 @@
+#include "config.h"
+#include "utils.h"
+#include "listing.h"
+
+static void
+copy_value(char *dst, int size, const char *value)
+{
+  snprintf(dst, size, "%s", value);
+}
+
+// return 0 if the key is known
+int
+config_set(struct Config *cfg, const char *key, const char *value)
+{
+  if(strcmp(key, "songlist_format") == 0)
+	copy_value(cfg->songlist_format, sizeof(cfg->songlist_format), value);
+  else if(strcmp(key, "directory_format") == 0)
+	copy_value(cfg->directory_format, sizeof(cfg->directory_format), value);
+  else if(strcmp(key, "fifo_path") == 0)
+	copy_value(cfg->fifo_path, sizeof(cfg->fifo_path), value);
+  else if(strcmp(key, "fifo_format") == 0)
+	copy_value(cfg->fifo_format, sizeof(cfg->fifo_format), value);
+  else if(strcmp(key, "music_directory") == 0)
+	copy_value(cfg->music_directory, sizeof(cfg->music_directory), value);
+  else if(strcmp(key, "directory_cache_kb") == 0)
+	cfg->directory_cache_kb = atoi(value) >= 0 ?
+	  atoi(value) : DEFAULT_DIRECTORY_CACHE_KB;
+  else if(strcmp(key, "directory_sort") == 0)
+	cfg->directory_sort = strcmp(value, "time") == 0 ? SORT_TIME
+	  : strcmp(value, "size") == 0 ? SORT_SIZE : SORT_NAME;
+  else if(strcmp(key, "visualizer_fps") == 0)
+	cfg->visualizer_fps = atoi(value) > 0 && atoi(value) <= 240 ?
+	  atoi(value) : DEFAULT_VISUALIZER_FPS;
+  else if(strcmp(key, "output_latency_ms") == 0)
+	cfg->output_latency_ms = atoi(value) > 0 ? atoi(value) : 0;
+  else
+	return 1;
+
+  return 0;
+}
+
+static char *
+trim(char *str)
+{
+  char *end;
+
+  while(isspace(*str)) str++;
+
+  end = str + strlen(str);
+  while(end > str && isspace(end[-1])) end--;
+  *end = '\0';
+
+  return str;
+}
+
+void
+config_load(struct Config *cfg, const char *path)
+{
+  char line[512], *key, *value, *pt;
+  FILE *fp = fopen(path, "r");
+
+  if(fp == NULL)
+	return;
+
+  while(fgets(line, sizeof(line), fp))
+	{
+	  if((pt = strchr(line, '#')) && !strchr(line, '"'))
+		*pt = '\0';
+
+	  if((pt = strchr(line, '=')) == NULL)
+		continue;
+
+	  *pt = '\0';
+	  key = trim(line);
+	  value = trim(pt + 1);
+
+	  // "quoted" value keeps its blanks and '#'
+	  if(*value == '"' && (pt = strrchr(value + 1, '"')))
+		{
+		  *pt = '\0';
+		  value++;
+		}
+
+	  config_set(cfg, key, value);
+	}
+
+  fclose(fp);
+}
+
+struct Config *config_setup(void)
+{
+  struct Config *cfg =
+	(struct Config*) malloc(sizeof(struct Config));
+  char path[512];
+  const char *home = getenv("HOME");
+
+  strncpy(cfg->songlist_format, DEFAULT_SONGLIST_FORMAT,
+		  sizeof(cfg->songlist_format));
+  cfg->output_latency_ms = DEFAULT_OUTPUT_LATENCY;
+  cfg->visualizer_fps = DEFAULT_VISUALIZER_FPS;
+  cfg->fifo_path[0] = cfg->fifo_format[0] = '\0';
+  cfg->music_directory[0] = '\0';
+  cfg->directory_cache_kb = DEFAULT_DIRECTORY_CACHE_KB;
+  cfg->directory_sort = 0; // by name
+  snprintf(cfg->directory_format, sizeof(cfg->directory_format), "%s",
+		   DEFAULT_DIRECTORY_FORMAT);
+
+  if(home)
+	{
+	  snprintf(path, sizeof(path), "%s/%s", home, CONFIG_FILE);
+	  config_load(cfg, path);
+	}
+
+  return cfg;
+}
+
+void config_free(struct Config *cfg)
+{
+  free(cfg);
+}
@@ -0,0 +1,49 @@
+#include "global.h"
+
+#ifndef QPWOEIRUTYALSKDJFHG
+#define QPWOEIRUTYALSKDJFHG
+
+#define CONFIG_FILE ".mpc_drc" // under $HOME
+
+#define DEFAULT_SONGLIST_FORMAT "%pos %title|48 %artist"
+#define DEFAULT_DIRECTORY_FORMAT "%pos %title %artist %time"
+#define DEFAULT_OUTPUT_LATENCY 250 // ms
+#define DEFAULT_VISUALIZER_FPS 30
+#define DEFAULT_DIRECTORY_CACHE_KB 4096
+
+/* user settings, read from ~/.mpc_drc whose lines look like
+ *     key = value
+ * '#' starts a comment, a value may be double quoted to keep
+ * its leading or trailing blanks */
+struct Config
+{
+  char songlist_format[256];
+
+  /* time from mpd writing to its fifo to the sound being heard,
+   * that is the buffer of the real audio output. mpd doesn't
+   * tell it, so it's left to the user */
+  int output_latency_ms;
+
+  int visualizer_fps; // frames a second, whatever the main loop does
+
+  // the mpd fifo output, empty to find it out
+  char fifo_path[512];
+  char fifo_format[32]; // like mpd's, "44100:16:2"
+
+  /* mpd's music_directory as seen from here, to browse the disk
+   * rather than mpd's database. empty to ask mpd */
+  char music_directory[512];
+  int directory_cache_kb; // memory for the listings browsed
+  int directory_sort; // enum listing_sort, "name", "time" or "size"
+  char directory_format[256]; // of the songs in columns, as songlist_format
+};
+
+struct Config *config;
+
+int config_set(struct Config *cfg, const char *key, const char *value);
+void config_load(struct Config *cfg, const char *path);
+
+struct Config *config_setup(void);
+void config_free(struct Config *cfg);
+
+#endif
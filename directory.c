@@ -2,6 +2,9 @@
 #include "windows.h"
 #include "utils.h"
 #include "keyboards.h"
+#include "config.h"
+#include "idle.h"
+#include "scanner.h"
 
 int is_dir_exist(const char *path)
 {
@@ -28,41 +31,80 @@ int is_path_exist(const char *path)
   return is_dir_exist(path) || is_nondir_exist(path);
 }
 
+// whether mpd can play path, by its suffix
 int is_path_valid_format(const char *path)
 {
-  const int music_format_num = 6;
+  return suffix_table_has(&directory->suffixes, path);
+}
+
+/* what a listed name is, from its mode bits; links are followed
+   by the stat before they get here */
+static int
+entry_kind(const char *name, mode_t mode)
+{
+  if(S_ISDIR(mode))
+	return ENTRY_DIR;
+  else if(S_ISREG(mode) && is_path_valid_format(name))
+	return ENTRY_SONG;
+  else
+	return ENTRY_HIDDEN;
+}
 
-  char valid_format[][12] = {
-	"mp3", "flac", "wav", "wma", "ape", "ogg"
-  };
+/* classify one readdir entry exactly once. d_type answers it
+   without a syscall on most local filesystems; only links and
+   filesystems that leave d_type unknown (some NFS, XFS v4) cost
+   an fstatat relative to the already open dirfd, which spares
+   re-resolving the whole path */
+static int
+classify_entry(int dfd, const struct dirent *ent)
+{
+  struct stat s;
 
-  char *path_suffix = strrchr(path, '.');
+  if(ent->d_name[0] == '.') // also skips "." and ".."
+	return ENTRY_HIDDEN;
 
-  int i;
-  
-  if(path_suffix)
+  switch(ent->d_type)
 	{
-	  for(i = 0; i < music_format_num; i++)
-		if(is_substring_ignorecase(path_suffix, valid_format[i]))
-		  return 1;
+	case DT_DIR:
+	  return ENTRY_DIR;
+	case DT_REG:
+	  return entry_kind(ent->d_name, S_IFREG);
+	case DT_LNK:
+	case DT_UNKNOWN:
+	  if(fstatat(dfd, ent->d_name, &s, 0) == 0)
+		return entry_kind(ent->d_name, s.st_mode);
+	  // fall through: a dangling link is not listed
+	default:
+	  return ENTRY_HIDDEN;
 	}
-  else
-	return 0;
+}
 
-  return 0;
+// a name inotify tells is new in the directory path
+static int
+classify_new(const char *path, const struct inotify_event *ev)
+{
+  char full[1024];
+  struct stat s;
+
+  if(ev->name[0] == '.')
+	return ENTRY_HIDDEN;
+  else if(ev->mask & IN_ISDIR)
+	return ENTRY_DIR;
+
+  snprintf(full, sizeof(full), "%s/%s", path, ev->name);
+  return stat(full, &s) ? ENTRY_HIDDEN : entry_kind(ev->name, s.st_mode);
 }
 
 // whether the path should be in the list
 int is_path_visible(const char *path)
 {
+  struct stat s;
   char *path_suffix = strrchr(path, '/');
 
-  if(!path_suffix)
+  if(!path_suffix || path_suffix[1] == '.')
 	return 0;
-  
-  return path_suffix[1] != '.' &&
-	(is_dir_exist(path)
-	 || (is_path_valid_format(path) && is_nondir_exist(path)));
+
+  return !stat(path, &s) && entry_kind(path, s.st_mode) != ENTRY_HIDDEN;
 }
 
 char* get_abs_path(const char *filename)
@@ -80,18 +122,53 @@ char* get_abs_path(const char *filename)
   
 	  snprintf(temp, 512, "%s/%s", crt_dir, filename);
 	}
+  else // mpd's root
+	snprintf(temp, 512, "%s", filename);
 
   return temp;
 }
 
 char* get_abs_crt_path(void)
 {
-  return get_abs_path(directory->filename[directory->cursor - 1]);
+  struct Listing *lst = directory->shown;
+  char *path;
+
+  if(lst == NULL || directory->cursor < 1)
+	return get_abs_path("");
+
+  // the scanner may be moving the strings
+  pthread_mutex_lock(&lst->lock);
+  path = get_abs_path(directory->cursor <= lst->length ?
+					  listing_name(lst, directory->cursor - 1) : "");
+  pthread_mutex_unlock(&lst->lock);
+
+  return path;
+}
+
+// of the entry under the cursor, ENTRY_HIDDEN if there's none
+static int
+crt_entry_kind(void)
+{
+  struct Listing *lst = directory->shown;
+  int kind = ENTRY_HIDDEN;
+
+  if(lst == NULL)
+	return kind;
+
+  pthread_mutex_lock(&lst->lock);
+  if(directory->cursor >= 1 && directory->cursor <= lst->length)
+	kind = listing_kind(lst, directory->cursor - 1);
+  pthread_mutex_unlock(&lst->lock);
+
+  return kind;
 }
 
 char* get_mpd_path(char *abs_path)
 {
   static char *root, *absp;
+
+  if(directory->source == SOURCE_MPD) // it's a uri already
+	return abs_path;
   
   root = directory->root_dir;
   absp = abs_path;
@@ -99,7 +176,7 @@ char* get_mpd_path(char *abs_path)
   while(*root && *absp && *root++ == *absp++);
 
   if(!*root) // current directory is under the root directory
-	return absp + 1;
+	return *absp == '/' ? absp + 1 : absp; // root_dir may end in '/'
   else
 	return NULL;
 } 
@@ -109,6 +186,13 @@ char* get_mpd_crt_path(void)
   return get_mpd_path(get_abs_crt_path());
 }
 
+// the i-th entry shown as mpd knows it, NULL if it can't, under lock
+static char *
+entry_mpd_path(struct Listing *lst, int i)
+{
+  return get_mpd_path(get_abs_path(listing_name(lst, i)));
+}
+
 int get_last_dir_id(void)
 {
   return directory->curs_history[directory->level];
@@ -128,23 +212,69 @@ void set_level_by(int offset)
 void directory_redraw_screen(void)
 {
   int line = 0, i, height = wchain[DIRECTORY].win->_maxy + 1;
+  struct Listing *lst = directory->shown;
+  int scanning = 0;
 
   WINDOW *win = specific_win(DIRECTORY);  
 
-  char *filename;
-  for(i = directory->begin - 1; i < directory->begin
-		+ height - 1 && i < directory->length; i++)
+  const int cols = win->_maxx - 6; // what's right of the id
+  char filename[128], pos[16], time[16], *uri;
+  struct FieldText fields[FIELD_NUM];
+  struct SongTags *tags;
+  int color;
+
+  memset(fields, 0, sizeof(fields));
+  fields[FIELD_POS].str = pos;
+  fields[FIELD_TIME].str = time;
+
+  if(lst)
 	{
-	  filename = directory->prettyname[i];
+	  pthread_mutex_lock(&lst->lock);
+	  for(i = directory->begin - 1; i < directory->begin
+			+ height - 1 && i < directory->length; i++)
+		{
+		  uri = entry_mpd_path(lst, i);
+
+		  if(i + 1 == directory->cursor) // cursor in
+			color = 2;
+		  else if(directory->marks.count && uri
+				  && marks_has(&directory->marks, uri)) // marked
+			color = 9;
+		  else
+			color = 0;
+
+		  // a song mpd has tags of in columns, the rest by its name
+		  tags = directory->columns && uri && listing_kind(lst, i) == ENTRY_SONG
+			? tag_cache_find(&directory->tags, uri) : NULL;
 
-	  if(i + 1 == directory->cursor)
-		print_list_item(win, line++, 2, i + 1, filename, NULL);
-	  else
-		print_list_item(win, line++, 0, i + 1, filename, NULL);
+		  if(tags && tags->known)
+			{
+			  snprintf(pos, sizeof(pos), "%3i.", i + 1);
+			  snprintf(time, sizeof(time), "%02u:%02u",
+					   tags->duration / 60, tags->duration % 60);
+			  fields[FIELD_TITLE].str = tags->title;
+			  fields[FIELD_TITLE].info = &tags->title_info;
+			  fields[FIELD_ARTIST].str = tags->artist;
+			  fields[FIELD_ARTIST].info = &tags->artist_info;
+			  fields[FIELD_ALBUM].str = tags->album;
+			  fields[FIELD_ALBUM].info = &tags->album_info;
+
+			  print_format_row(win, line++, color, &directory->format,
+							   fields, &directory->tags.text);
+			  continue;
+			}
+
+		  text_fit(filename, sizeof(filename), listing_label(lst, i),
+				   listing_info(lst, i), &lst->text, cols);
+		  print_list_item(win, line++, color, i + 1, filename, NULL);
+		}
+	  scanning = lst->state == LISTING_SCANNING;
+	  pthread_mutex_unlock(&lst->lock);
 	}
 
   if(directory->length < 1) // no item in the list
-	print_list_item(win, line, 1, 0, "no item in the list", NULL);
+	print_list_item(win, line, 1, 0, scanning ? "listing..."
+					: "no item in the list", NULL);
 }
 
 void
@@ -166,15 +296,19 @@ directory_helper(void)
 {
   WINDOW *win = specific_win(DIRHELPER);
 
-  wmove(win, 2, 0);
+  wmove(win, 1, 0);
   wprintw(win,  "\
-   <k>\t  Move Cursor Up\n\
-   <j>\t  Move Cursor Down\n\
+   j/k\t  Move Cursor\n\
    Ent\t  Enter Directory\n\
    Bck\t  Exit  Directory");
   color_print(win, 6, "\n\
    [a]\t  Append to Current\n\
-   [r]\t  Replace Current");
+   [r]\t  Replace Current\n\
+   [m]\t  Mark Entry\n\
+   [M]\t  Mark Up To Last\n\
+   [C]\t  Clear Marks\n\
+   [o]\t  Cycle Sort Order\n\
+   [i]\t  Toggle Tag Columns");
   wprintw(win, "\n\
    [c]\t  Clear Current");
 
@@ -184,68 +318,749 @@ directory_helper(void)
   color_print(win, 3, "Instruction:");
 }
 
+/* an entry's mtime and size, a directory's size isn't compared.
+   -1 for what fstatat() can't tell */
+static void
+stat_entry(int dfd, const char *name, long long *mtime, long long *size)
+{
+  struct stat s;
+
+  *mtime = *size = -1;
+  if(fstatat(dfd, name, &s, 0) == 0)
+	{
+	  *mtime = s.st_mtime;
+	  *size = S_ISDIR(s.st_mode) ? -1 : s.st_size;
+	}
+}
+
+/* fills lst from the disk, on the scanner's thread. the stat
+   classify_entry() mostly saves is only made for an order that
+   needs it, see stat_entries() */
+static int
+scan_local(struct Listing *lst)
+{
+  struct dirent *dir;
+  long long mtime = -1, size = -1;
+  int kind;
+  DIR *d;
+
+  if((d = opendir(lst->uri)) == NULL)
+	return 1;
+
+  while((dir = readdir(d)) != NULL
+		&& !__atomic_load_n(&lst->cancelled, __ATOMIC_ACQUIRE))
+	{
+	  kind = classify_entry(dirfd(d), dir);
+	  if(kind != ENTRY_HIDDEN)
+		{
+		  if(lst->sort != SORT_NAME)
+			stat_entry(dirfd(d), dir->d_name, &mtime, &size);
+		  listing_push(lst, kind, dir->d_name, NULL, mtime, size);
+		  scanner_progress(lst);
+		}
+	}
+
+  closedir(d);
+
+  return 0;
+}
+
+/* the scanner's fill(), mpd's listings come through a connection
+   of its own which is set up again after a failure */
+static int
+directory_fill(struct Listing *lst)
+{
+  if(directory->source == SOURCE_LOCAL)
+	return scan_local(lst);
+
+  if(directory->scan_conn == NULL)
+	{
+	  directory->scan_conn = mpd_connection_new(NULL, 0, 0);
+	  if(directory->scan_conn == NULL)
+		return 1;
+	}
+
+  if(mpd_connection_get_error(directory->scan_conn) != MPD_ERROR_SUCCESS
+	 || listing_fetch(lst, directory->scan_conn))
+	{
+	  mpd_connection_free(directory->scan_conn);
+	  directory->scan_conn = NULL;
+	  return 1;
+	}
+
+  return 0;
+}
+
+/* a disk listing scanned in name order has no mtimes nor sizes,
+   they're looked up once it's ordered by them */
+static void
+stat_entries(struct Listing *lst)
+{
+  int i, dfd;
+
+  if(directory->source != SOURCE_LOCAL
+	 || (dfd = open(lst->uri, O_RDONLY | O_DIRECTORY)) < 0)
+	return;
+
+  for(i = 0; i < lst->count; i++)
+	if(lst->sortkey[i].mtime < 0)
+	  stat_entry(dfd, lst->strings + lst->name[i],
+				 &lst->sortkey[i].mtime, &lst->sortkey[i].size);
+
+  close(dfd);
+}
+
+// order the shown listing by directory->sort, the cursor stays on its entry
+static void
+sort_shown(void)
+{
+  struct Listing *lst = directory->shown;
+  int entry = -1, i;
+
+  if(directory->cursor >= 1 && directory->cursor <= lst->length)
+	entry = lst->order[directory->cursor - 1];
+
+  if(directory->sort != SORT_NAME)
+	stat_entries(lst);
+  listing_sort(lst, directory->sort);
+
+  for(i = 0; i < lst->length; i++)
+	if(lst->order[i] == entry)
+	  directory_scroll_to(i + 1);
+}
+
+/* take in what the scanner has put in the shown listing so far,
+   the cursor goes to want_cursor once there're that many entries */
+static void
+directory_sync(void)
+{
+  struct Listing *lst = directory->shown;
+  int state, want = directory->want_cursor;
+
+  pthread_mutex_lock(&lst->lock);
+  directory->length = lst->length;
+  state = lst->state;
+  pthread_mutex_unlock(&lst->lock);
+
+  if(want && (directory->length >= want || state != LISTING_SCANNING))
+	{
+	  directory_scroll_to(want < directory->length ? want : directory->length);
+	  directory->want_cursor = 0;
+	}
+  else if(directory->length > 0 && directory->cursor > directory->length)
+	directory_scroll_to(directory->length); // it has shrunk
+
+  /* mpd's are kept until the idle connection hears of a database
+	 change, without it they aren't kept at all */
+  if(state == LISTING_SCANNING)
+	return;
+
+  if(lst->sort != directory->sort) // it was listed in another order
+	sort_shown();
+
+  if(lst->dirty) // what the scan saw is uncertain, once more
+	directory->update_signal = 1;
+  else if(state == LISTING_DONE && !lst->cached
+		  && (directory->source == SOURCE_LOCAL || idle_alive()))
+	listing_cache_put(&directory->cache, lst);
+}
+
+// a finished prefetch goes to the cache, unless it's no good
+static void
+prefetch_take(void)
+{
+  struct Listing *lst = directory->prefetch;
+  int state;
+
+  pthread_mutex_lock(&lst->lock);
+  state = lst->state;
+  pthread_mutex_unlock(&lst->lock);
+
+  if(state == LISTING_SCANNING)
+	return;
+
+  directory->prefetch = NULL;
+
+  if(state == LISTING_DONE && !lst->dirty
+	 && (directory->source == SOURCE_LOCAL || idle_alive()))
+	listing_cache_put(&directory->cache, lst);
+  else
+	listing_free(lst);
+}
+
+static void
+prefetch_release(void)
+{
+  struct Listing *lst = directory->prefetch;
+
+  if(lst == NULL)
+	return;
+
+  directory->prefetch = NULL;
+
+  if(!scanner_cancel(lst))
+	listing_free(lst);
+}
+
+/* after PREFETCH_IDLE_US without a key, list ahead what the next
+   Enter most likely opens: the directory under the cursor, then
+   the ones beside it. one at a time, each tried once till a key,
+   and never in the way of the shown listing's scan */
+static void
+directory_prefetch(void)
+{
+  const int offsets[] = {0, 1, -1};
+  struct Listing *lst = directory->shown;
+  char path[512];
+  struct stat s;
+  int i, k, kind;
+
+  if(lst == NULL || directory->prefetch
+	 || get_monotonic_us() - directory->input_us < PREFETCH_IDLE_US
+	 || (directory->source == SOURCE_MPD && !idle_alive()))
+	return;
+
+  for(k = 0; k < 3; k++)
+	{
+	  if(directory->guessed & 1 << k)
+		continue;
+
+	  i = directory->cursor - 1 + offsets[k];
+	  kind = ENTRY_HIDDEN;
+
+	  pthread_mutex_lock(&lst->lock);
+	  if(lst->state != LISTING_SCANNING && i >= 0 && i < lst->length
+		 && (kind = listing_kind(lst, i)) == ENTRY_DIR)
+		snprintf(path, sizeof(path), "%s", get_abs_path(listing_name(lst, i)));
+	  pthread_mutex_unlock(&lst->lock);
+
+	  if(kind != ENTRY_DIR)
+		continue;
+
+	  directory->guessed |= 1 << k;
+	  if(listing_cache_peek(&directory->cache, path))
+		continue;
+
+	  directory->prefetch = listing_new(path);
+	  directory->prefetch->sort = directory->sort;
+	  if(directory->source == SOURCE_LOCAL && stat(path, &s) == 0)
+		{
+		  directory->prefetch->mtime = s.st_mtim;
+		  listing_watch(directory->prefetch);
+		}
+	  scanner_prefetch(directory->prefetch);
+	  return;
+	}
+}
+
+// a key is in, the guesses made for the previous cursor are off
+void
+directory_prefetch_stop(void)
+{
+  directory->input_us = get_monotonic_us();
+  directory->guessed = 0;
+  prefetch_release();
+}
+
+// the scanner's on_progress()
+static void
+directory_on_progress(void)
+{
+  if(directory->prefetch)
+	prefetch_take();
+
+  if(directory->shown)
+	{
+	  directory_sync();
+	  signal_win(DIRECTORY);
+	}
+}
+
+/* the listing of crt_dir, from the cache while it's good: mpd's
+   until a database change, the disk's while the directory's mtime
+   stays. otherwise a new one that the scanner fills */
+static struct Listing *
+directory_listing(void)
+{
+  const char *path = directory->crt_dir;
+  struct Listing *lst = listing_cache_get(&directory->cache, path);
+  struct timespec mtime = {0, 0};
+  struct stat s;
+
+  // it's been guessed right, show it as far as it's got
+  if(directory->prefetch && strcmp(directory->prefetch->uri, path) == 0)
+	{
+	  lst = directory->prefetch;
+	  directory->prefetch = NULL;
+	  return lst;
+	}
+
+  if(directory->source == SOURCE_LOCAL)
+	{
+	  if(lst && lst->wd >= 0) // it has been kept up to date
+		return lst;
+
+	  if(stat(path, &s) != 0) // it's gone, show it empty
+		{
+		  lst = listing_new(path);
+		  lst->state = LISTING_BROKEN;
+		  return lst;
+		}
+
+	  mtime = s.st_mtim;
+	  if(lst && lst->mtime.tv_sec == mtime.tv_sec
+		 && lst->mtime.tv_nsec == mtime.tv_nsec)
+		return lst;
+	}
+  else if(lst)
+	return lst;
+
+  // watched and stat'ed before the scan, so no change is missed
+  lst = listing_new(path);
+  lst->mtime = mtime;
+  lst->sort = directory->sort;
+  if(directory->source == SOURCE_LOCAL)
+	listing_watch(lst);
+  prefetch_release(); // a wrong guess, not to hold the scanner up
+  scanner_start(lst);
+
+  return lst;
+}
+
+// let go of the shown listing, to the cache or the scanner if theirs
+static void
+directory_release(void)
+{
+  struct Listing *lst = directory->shown;
+
+  if(lst == NULL)
+	return;
+
+  directory->shown = directory->cache.pinned = NULL;
+
+  if(!lst->cached && !scanner_cancel(lst))
+	listing_free(lst);
+}
+
+// show crt_dir, the cursor is left to the caller's want_cursor
 void
 directory_update(void)
 {
-  DIR *d;
-  struct dirent *dir;
+  struct Listing *lst;
 
-  d = opendir(directory->crt_dir);
-  
-  if(d)
+  directory_release();
+
+  lst = directory_listing();
+  directory->shown = directory->cache.pinned = lst;
+
+  directory_sync();
+}
+
+// remember the cursor of the directory being left
+static void
+save_view(void)
+{
+  if(directory->shown)
+	directory->shown->cursor = directory->cursor;
+}
+
+// the shown listing or a cached one watched as wd
+static struct Listing *
+watched_listing(int wd)
+{
+  struct Listing *lst = directory->shown;
+
+  if(lst && lst->wd == wd)
+	return lst;
+
+  if((lst = directory->prefetch) && lst->wd == wd)
+	return lst;
+
+  for(lst = directory->cache.newest; lst; lst = lst->older)
+	if(lst->wd == wd)
+	  return lst;
+
+  return NULL;
+}
+
+/* a change inotify reports of lst's directory, made to lst in
+   place. returns whether the shown listing has changed */
+static int
+apply_change(struct Listing *lst, const struct inotify_event *ev)
+{
+  size_t before = listing_bytes(lst);
+  long long mtime = -1, size = -1;
+  int i, kind, dfd;
+
+  if(ev->mask & IN_IGNORED) // the watch is gone
 	{
+	  listing_unwatch(lst);
+	  return 0;
+	}
 
-	  dir = readdir(d); // skip the directory itself
+  if(ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+	{
+	  if(lst->cached)
+		listing_cache_drop(&directory->cache, lst);
+	  if(lst == directory->shown)
+		directory->update_signal = 1;
+	  return 0;
+	}
 
-	  int i = 0;
-  
-	  while ((dir = readdir(d)) != NULL)
+  if(lst->state == LISTING_SCANNING)
+	{
+	  lst->dirty = 1;
+	  return 0;
+	}
+
+  if(ev->mask & (IN_DELETE | IN_MOVED_FROM))
+	{
+	  if((i = listing_find(lst, ev->name)) < 0)
+		return 0;
+
+	  listing_remove(lst, i);
+	  // keep the cursor on the entry it was on
+	  if(lst == directory->shown && i < directory->cursor - 1)
 		{
-		  char * absp = get_abs_path(dir->d_name);
-		  if(is_path_visible(absp))
-			{
-			  strncpy(directory->filename[i], dir->d_name, 128);
-			  pretty_copy(directory->prettyname[i], dir->d_name, 127, 24);
-			  if(is_dir_exist(absp))
-				{
-				  char *pname = directory->prettyname[i];
-				  int j = strlen(pname);
-				  pname[j] = '/';
-				  pname[j + 1] = '\0';
-				}
-			  i++;
-			}
+		  directory->length = lst->length;
+		  directory_scroll_to(directory->cursor - 1);
+		}
+	}
+  else if(ev->mask & (IN_CREATE | IN_MOVED_TO))
+	{
+	  kind = classify_new(lst->uri, ev);
+	  if(kind == ENTRY_HIDDEN || listing_find(lst, ev->name) >= 0)
+		return 0;
+
+	  if(lst->sort != SORT_NAME
+		 && (dfd = open(lst->uri, O_RDONLY | O_DIRECTORY)) >= 0)
+		{
+		  stat_entry(dfd, ev->name, &mtime, &size);
+		  close(dfd);
 		}
+	  listing_push(lst, kind, ev->name, NULL, mtime, size);
+	  listing_publish(lst);
+
+	  // in its place in order, the cursor's entry may move down
+	  i = listing_find(lst, ev->name);
+	  if(lst == directory->shown && i < directory->cursor - 1)
+		{
+		  directory->length = lst->length;
+		  directory_scroll_to(directory->cursor + 1);
+		}
+	}
 
-	  directory->length = i;
+  if(lst->cached)
+	listing_cache_resized(&directory->cache, lst, before);
 
-	  closedir(d);
+  return lst == directory->shown;
+}
+
+// listing_notify is readable
+static void
+directory_on_notify(void)
+{
+  char buff[4096]
+	__attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *ev;
+  struct Listing *lst;
+  int changed = 0;
+  ssize_t len;
+  char *pt;
+
+  while((len = read(listing_notify, buff, sizeof(buff))) > 0)
+	for(pt = buff; pt < buff + len;
+		pt += sizeof(struct inotify_event) + ev->len)
+	  {
+		ev = (const struct inotify_event*) pt;
+
+		if(ev->mask & IN_Q_OVERFLOW) // changes lost, trust nothing
+		  {
+			listing_cache_clear(&directory->cache);
+			directory->update_signal = 1;
+		  }
+		else if((lst = watched_listing(ev->wd)) != NULL)
+		  changed |= apply_change(lst, ev);
+	  }
+
+  if(changed)
+	{
+	  directory_sync();
+	  signal_win(DIRECTORY);
 	}
 }
 
+static void
+directory_on_database(enum mpd_idle events)
+{
+  listing_cache_clear(&directory->cache);
+  tag_cache_clear(&directory->tags);
+
+  if(directory->source == SOURCE_MPD)
+	directory->update_signal = 1;
+}
+
+/* ask mpd of the n songs in uri all in one command list, rather
+   than a round trip each. one it doesn't have stops the list, it's
+   kept as unknown and those after it are asked again next time */
+static void
+fetch_tags(char (*uri)[512], int n)
+{
+  struct mpd_entity *entity;
+  int i, failed = n;
+
+  if(!mpd_command_list_begin(conn, true))
+	printErrorAndExit(conn);
+  for(i = 0; i < n; i++)
+	mpd_send_list_meta(conn, uri[i]);
+  if(!mpd_command_list_end(conn))
+	printErrorAndExit(conn);
+
+  for(i = 0; i < n; i++)
+	{
+	  while((entity = mpd_recv_entity(conn)) != NULL)
+		{
+		  if(mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG)
+			tag_cache_put(&directory->tags, uri[i],
+						  mpd_entity_get_song(entity));
+		  mpd_entity_free(entity);
+		}
+
+	  if(!mpd_response_next(conn))
+		break;
+	}
+
+  if(!mpd_response_finish(conn))
+	{
+	  if(mpd_connection_get_error(conn) != MPD_ERROR_SERVER)
+		printErrorAndExit(conn);
+	  failed = mpd_connection_get_server_error_location(conn);
+	  mpd_connection_clear_error(conn);
+	}
+
+  for(i = 0; i < n && i <= failed; i++)
+	if(tag_cache_find(&directory->tags, uri[i]) == NULL)
+	  tag_cache_put(&directory->tags, uri[i], NULL);
+}
+
+// the tags of the songs on the screen that aren't in the cache yet
+static void
+directory_fetch_tags(void)
+{
+  int height = wchain[DIRECTORY].win->_maxy + 1, i, n = 0;
+  struct Listing *lst = directory->shown;
+  char (*uri)[512], *path;
+
+  if(!directory->columns || lst == NULL)
+	return;
+
+  uri = malloc(height * sizeof(*uri));
+
+  pthread_mutex_lock(&lst->lock);
+  for(i = directory->begin - 1; i < directory->begin + height - 1
+		&& i < lst->length; i++)
+	if(listing_kind(lst, i) == ENTRY_SONG
+	   && (path = entry_mpd_path(lst, i)) != NULL
+	   && tag_cache_find(&directory->tags, path) == NULL)
+	  snprintf(uri[n++], sizeof(*uri), "%s", path);
+  pthread_mutex_unlock(&lst->lock);
+
+  if(n > 0)
+	{
+	  fetch_tags(uri, n);
+	  signal_win(DIRECTORY);
+	}
+
+  free(uri);
+}
+
+// show the songs by their tags in columns, or by their names
+void
+directory_toggle_columns(void)
+{
+  directory->columns = !directory->columns;
+}
+
+/* what changes on the disk is mostly applied by
+   directory_on_notify(), what can't be is listed again here */
 void directory_update_checking(void)
 {
-  // TODO, when modification happened then update
   if(directory->update_signal)
 	{
+	  directory->want_cursor = directory->cursor;
 	  directory_update();
 	  directory->update_signal = 0;
 	  signal_all_wins();
 	}
+
+  directory_fetch_tags();
+  directory_prefetch();
+}
+
+// whether the entry under the cursor can be added to the queue
+static int
+crt_entry_addable(void)
+{
+  if(crt_entry_kind() == ENTRY_HIDDEN)
+	return 0;
+
+  // a file on the disk may be gone since it was listed
+  return directory->source == SOURCE_MPD
+	|| is_path_exist(get_abs_crt_path());
+}
+
+/* mark the entries shown from..to, or unmark them. they're
+   remembered by uri, leaving the directory doesn't lose them */
+static void
+mark_entries(int from, int to, int mark)
+{
+  struct Listing *lst = directory->shown;
+  char *uri;
+  int i;
+
+  if(lst == NULL)
+	return;
+
+  pthread_mutex_lock(&lst->lock);
+  for(i = from; i <= to; i++)
+	if(i >= 1 && i <= lst->length
+	   && (uri = entry_mpd_path(lst, i - 1)) != NULL)
+	  {
+		if(mark)
+		  marks_add(&directory->marks, uri);
+		else
+		  marks_remove(&directory->marks, uri);
+	  }
+  pthread_mutex_unlock(&lst->lock);
 }
 
+// mark the entry under the cursor or unmark it, then go down one
 void
-append_to_songlist(void)
+directory_toggle_mark(void)
 {
-  char *path, *absp;
+  struct Listing *lst = directory->shown;
+  int cursor = directory->cursor, marked = 0;
+  char *uri;
 
-  /* check if path exist */
-  absp = get_abs_crt_path();
-  if(!is_path_exist(absp))
+  if(lst == NULL)
 	return;
 
-  /* check if a nondir file of valid format */
-  if(!is_dir_exist(absp) && !is_path_valid_format(absp))
+  pthread_mutex_lock(&lst->lock);
+  if(cursor >= 1 && cursor <= lst->length
+	 && (uri = entry_mpd_path(lst, cursor - 1)) != NULL)
+	marked = marks_has(&directory->marks, uri);
+  pthread_mutex_unlock(&lst->lock);
+
+  mark_entries(cursor, cursor, !marked);
+  directory->anchor = cursor;
+
+  directory_scroll_down_line();
+}
+
+// mark all from the latest toggled entry of this directory to the cursor
+void
+directory_mark_range(void)
+{
+  int anchor = directory->anchor ? directory->anchor : directory->cursor;
+
+  if(anchor <= directory->cursor)
+	mark_entries(anchor, directory->cursor, 1);
+  else
+	mark_entries(directory->cursor, anchor, 1);
+
+  directory->anchor = directory->cursor;
+}
+
+void
+directory_clear_marks(void)
+{
+  marks_clear(&directory->marks);
+  directory->anchor = 0;
+}
+
+/* the marked uris in one command list, after a clear if replace,
+   rather than a round trip each. a file on the disk that's gone is
+   left out, mpd would stop the list at it */
+static void
+add_marked(int replace)
+{
+  struct Marks *marks = &directory->marks;
+  char full[1024], message[512];
+  const char **uri;
+  int i, sent = 0;
+
+  // what's gone from the disk is left out, before the queue is touched
+  uri = (const char**) malloc(marks->length * sizeof(const char*));
+  for(i = 0; i < marks->length; i++)
+	{
+	  if(marks->uri[i] == NULL)
+		continue;
+
+	  snprintf(full, sizeof(full), "%s/%s", directory->root_dir, marks->uri[i]);
+	  if(directory->source == SOURCE_LOCAL && !is_path_exist(full))
+		continue;
+
+	  uri[sent++] = marks->uri[i];
+	}
+
+  if(sent == 0)
+	{
+	  free(uri);
+	  popup_simple_dialog("The Marked Items Are Gone.");
+	  return;
+	}
+
+  if(!mpd_command_list_begin(conn, false))
+	printErrorAndExit(conn);
+
+  if(replace)
+	mpd_send_clear(conn);
+
+  for(i = 0; i < sent; i++)
+	mpd_send_add(conn, uri[i]);
+  free(uri);
+
+  if(!mpd_command_list_end(conn))
+	printErrorAndExit(conn);
+
+  if(mpd_response_finish(conn))
+	{
+	  snprintf(message, sizeof(message), replace ? "Replace With %i Items."
+			   : "%i Items Have Been Appended.", sent);
+	  directory_clear_marks();
+	}
+  else // what's before the failed one is in
+	{
+	  snprintf(message, sizeof(message), "Adding Stopped: %s",
+			   mpd_connection_get_error_message(conn));
+	  mpd_connection_clear_error(conn);
+	}
+
+  popup_simple_dialog(message);
+}
+
+// the next order of the listings, by name, time or size
+void
+directory_cycle_sort(void)
+{
+  directory->sort = (directory->sort + 1) % SORT_MODES;
+
+  if(directory->shown)
+	directory_sync();
+}
+
+void
+append_to_songlist(void)
+{
+  char *path;
+
+  if(directory->marks.count)
+	{
+	  add_marked(0);
+	  return;
+	}
+
+  if(!crt_entry_addable())
 	return;
   
   path = get_mpd_crt_path();
@@ -261,7 +1076,7 @@ append_to_songlist(void)
 
 void replace_songlist(void)
 {
-  char *path, *absp;
+  char *path;
 
   int choice =
 	popup_confirm_dialog("Replacing Confirm:", 0);
@@ -269,13 +1084,13 @@ void replace_songlist(void)
   if(!choice) // action canceled
 	return;
 
-  /* check if path exist */
-  absp = get_abs_crt_path();
-  if(!is_path_exist(absp))
-	return;
+  if(directory->marks.count)
+	{
+	  add_marked(1);
+	  return;
+	}
 
-  /* check if a nondir file of valid format */
-  if(!is_dir_exist(absp) && !is_path_valid_format(absp))
+  if(!crt_entry_addable())
 	return;
   
   path = get_mpd_crt_path();
@@ -300,8 +1115,38 @@ struct Directory* directory_setup(void)
   dir->length = 0;
   dir->cursor = 1;
   dir->level = 0;
-  strncpy(dir->root_dir, "/home/ted/Music", 128);
-  strncpy(dir->crt_dir, dir->root_dir, 512);
+
+  dir->shown = NULL;
+  dir->want_cursor = 1;
+  dir->scan_conn = NULL;
+  dir->prefetch = NULL;
+  dir->guessed = 0;
+  dir->input_us = 0;
+  dir->sort = config->directory_sort;
+  memset(&dir->marks, 0, sizeof(dir->marks));
+  memset(&dir->tags, 0, sizeof(dir->tags));
+  dir->columns = 0;
+  if(row_format_compile(&dir->format, config->directory_format) < 0)
+	row_format_compile(&dir->format, DEFAULT_DIRECTORY_FORMAT);
+  dir->anchor = 0;
+  memset(&dir->cache, 0, sizeof(dir->cache));
+  dir->cache.budget = config->directory_cache_kb * 1024;
+
+  // the disk is browsed only when told where mpd's music is
+  dir->source = *config->music_directory ? SOURCE_LOCAL : SOURCE_MPD;
+  if(dir->source == SOURCE_LOCAL) // mpd's listings have only what it plays
+	suffix_table_load(&dir->suffixes, conn);
+  else
+	memset(&dir->suffixes, 0, sizeof(dir->suffixes));
+  snprintf(dir->root_dir, sizeof(dir->root_dir), "%s", config->music_directory);
+  snprintf(dir->crt_dir, sizeof(dir->crt_dir), "%s", dir->root_dir);
+  idle_listen(MPD_IDLE_DATABASE, directory_on_database);
+  scanner = scanner_setup(directory_fill, directory_on_progress);
+
+  listing_notify = -1;
+  if(dir->source == SOURCE_LOCAL
+	 && (listing_notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) >= 0)
+	watch_fd(listing_notify, directory_on_notify);
 
   // window mode setup
   dir->wmode.size = 6;
@@ -320,6 +1165,20 @@ struct Directory* directory_setup(void)
 
 void directory_free(struct Directory *dir)
 {
+  directory_release();
+  prefetch_release();
+  scanner_free(scanner); // the thread is done with scan_conn after it
+  listing_cache_clear(&dir->cache);
+  if(dir->scan_conn)
+	mpd_connection_free(dir->scan_conn);
+  if(listing_notify >= 0)
+	{
+	  unwatch_fd(listing_notify);
+	  close(listing_notify);
+	}
+  marks_clear(&dir->marks);
+  suffix_table_free(&dir->suffixes);
+  tag_cache_free(&dir->tags);
   free(dir->wmode.wins);
   free(dir);
 }
@@ -327,40 +1186,46 @@ void directory_free(struct Directory *dir)
 void
 enter_selected_dir(void)
 {
-  char *temp =  get_abs_crt_path();
-  
-  if(is_dir_exist(temp))
+  if(crt_entry_kind() == ENTRY_DIR)
 	{
-	  strcpy(directory->crt_dir, temp);
+	  save_view();
+	  strcpy(directory->crt_dir, get_abs_crt_path());
 
 	  directory->curs_history[directory->level] = directory->cursor;
+	  directory->anchor = 0;
 	  set_level_by(1); // level++
 
-	  directory_scroll_to(1);
-	  directory->update_signal = 1;
+	  directory_update();
+	  directory->want_cursor =
+		directory->shown->cursor ? directory->shown->cursor : 1;
+	  directory_sync();
 	}
 }
 
 int // if succeed return 0
 exit_current_dir(void)
 {
-  char *p;
-
-  p = strrchr(directory->crt_dir, '/');
+  char *crt = directory->crt_dir, *p = strrchr(crt, '/');
+  int root_len = strlen(directory->root_dir);
 
   // prehibit exiting from root directory
-  if(p - directory->crt_dir < (int)strlen(directory->root_dir))
+  if((int)strlen(crt) <= root_len)
 	return 1;
 
-  if(p && p != directory->crt_dir)
-	{
-	  *p = '\0';
+  save_view();
 
-	  set_level_by(-1); // level--
+  if(p && p - crt >= root_len)
+	*p = '\0';
+  else // the parent is the root, mpd's "" has no '/' to cut at
+	strcpy(crt, directory->root_dir);
 
-	  directory_update(); // must be done before scrolling
-	  directory_scroll_to(get_last_dir_id());
-	}
+  directory->anchor = 0;
+  set_level_by(-1); // level--
+
+  directory_update(); // must be done before scrolling
+  directory->want_cursor = directory->shown->cursor ?
+	directory->shown->cursor : get_last_dir_id();
+  directory_sync();
 
   return 0;
 }
@@ -378,6 +1243,7 @@ void
 directory_scroll_down_line(void)
 {
   int height = wchain[DIRECTORY].win->_maxy + 1;
+  directory->want_cursor = 0; // the user has taken over
   scroll_line_shift_style(&directory->cursor, &directory->begin,
 						  directory->length, height, +1);
 }
@@ -386,6 +1252,7 @@ void
 directory_scroll_up_line(void)
 {
   int height = wchain[DIRECTORY].win->_maxy + 1;
+  directory->want_cursor = 0; // the user has taken over
   scroll_line_shift_style(&directory->cursor, &directory->begin,
 						  directory->length, height, -1);  
 }
@@ -394,6 +1261,7 @@ void
 directory_scroll_up_page(void)
 {
   int height = wchain[DIRECTORY].win->_maxy + 1;
+  directory->want_cursor = 0; // the user has taken over
   scroll_line_shift_style(&directory->cursor, &directory->begin,
 						  directory->length, height, -15);  
 }
@@ -402,6 +1270,7 @@ void
 directory_scroll_down_page(void)
 {
   int height = wchain[DIRECTORY].win->_maxy + 1;
+  directory->want_cursor = 0; // the user has taken over
   scroll_line_shift_style(&directory->cursor, &directory->begin,
 						  directory->length, height, +15);  
 }
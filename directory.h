@@ -1,15 +1,56 @@
 #include "global.h"
 #include "windows.h"
+#include "text.h"
+#include "listing.h"
+#include "marks.h"
+#include "suffixes.h"
+#include "tags.h"
+#include "format.h"
 
 #ifndef LKAJSDOIFNAOCW9O8IFJ
 #define LKAJSDOIFNAOCW9O8IFJ
 
+#define PREFETCH_IDLE_US 300000 // no key for that long, guess the next Enter
+
+// where the browsed directories come from
+enum browse_source
+  {
+	SOURCE_MPD,   // mpd's database, by lsinfo, also for a remote mpd
+	SOURCE_LOCAL  // the disk under config's music_directory
+  };
+
 struct Directory
 {
-  char root_dir[128];
+  int source; // enum browse_source
+  char root_dir[512]; // "" for mpd's root
   char crt_dir[512];
-  char filename[MAX_SONGLIST_STORE_LENGTH][512]; // all items in current dir
-  char prettyname[MAX_SONGLIST_STORE_LENGTH][128]; // all items in current dir
+
+  /* all items in current dir, it may still be filling on the
+   * scanner's thread, see directory_sync() */
+  struct Listing *shown;
+  int want_cursor; // where the cursor goes once it's listed that far
+  struct mpd_connection *scan_conn; // the scanner thread's own
+
+  // a directory listed ahead for the cache, see directory_prefetch()
+  struct Listing *prefetch;
+  int guessed; // the guesses tried since the latest key, a bit each
+  long long input_us; // of the latest key
+
+  int sort; // enum listing_sort, of all listings as they're shown
+
+  // picked for a batch add, see add_marked()
+  struct Marks marks;
+  int anchor; // the latest entry toggled, where a range starts, 0 if none
+
+  struct SuffixTable suffixes; // of the files listed from the disk
+
+  // songs shown by their tags, see directory_fetch_tags()
+  int columns;
+  struct RowFormat format;
+  struct TagCache tags;
+
+  // the listings browsed by uri, see directory_listing()
+  struct ListingCache cache;
 
   struct WinMode wmode; // windows in this mode
 
@@ -41,6 +82,12 @@ void directory_display_icon(void);
 void directory_helper(void);
 void directory_update(void);
 void directory_update_checking(void);
+void directory_prefetch_stop(void);
+void directory_cycle_sort(void);
+void directory_toggle_mark(void);
+void directory_mark_range(void);
+void directory_clear_marks(void);
+void directory_toggle_columns(void);
 
 void append_to_songlist(void);
 void replace_songlist(void);
@@ -0,0 +1,566 @@
+#include "dsp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SPECTRUM_LOW_HZ 30.f
+#define SPECTRUM_HIGH_HZ 16000.f
+#define SPECTRUM_FLOOR_DB -60.f
+
+// ballistics, in full heights or seconds
+#define LEVEL_FALL 1.5f
+#define PEAK_HOLD 0.6f
+#define PEAK_FALL 0.8f
+
+int
+sample_bytes(int format)
+{
+  return format == SAMPLE_S16 ? 2 : 4;
+}
+
+/* n samples to floats in [-1, 1], four at a time where SSE2
+   is there, the scalar loops finish off the rest */
+static void
+convert_s16(float *dst, const int16_t *src, int n)
+{
+  const float scale = 1.f / 32768.f;
+  int i = 0;
+#ifdef __SSE2__
+  const __m128 k = _mm_set1_ps(scale);
+  for(; i + 8 <= n; i += 8)
+	{
+	  __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+	  // widened by the sign, the sample in the high half
+	  __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+	  __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+	  _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+	  _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+	}
+#endif
+  for(; i < n; i++)
+	dst[i] = src[i] * scale;
+}
+
+static void
+convert_s32(float *dst, const int32_t *src, int n, int bits)
+{
+  const float scale = 1.f / (1u << (bits - 1));
+  const int shift = 32 - bits; // sign bits above a 24 bit sample
+  int i = 0;
+#ifdef __SSE2__
+  const __m128 k = _mm_set1_ps(scale);
+  for(; i + 4 <= n; i += 4)
+	{
+	  __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+	  x = _mm_srai_epi32(_mm_slli_epi32(x, shift), shift);
+	  _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(x), k));
+	}
+#endif
+  for(; i < n; i++)
+	dst[i] = ((int32_t)((uint32_t)src[i] << shift) >> shift) * scale;
+}
+
+/* frames of the fifo to stereo floats. mono is doubled, beyond
+   two channels only the first two are kept. the conversion
+   runs in place at the end of dst, so dst takes frames * max(2,
+   channels) floats */
+void
+sample_convert(float *dst, const void *src, int frames,
+			   int format, int channels)
+{
+  const int n = frames * channels;
+  float *tmp = channels > 2 ? dst : dst + 2 * frames - n;
+  int i;
+
+  switch(format)
+	{
+	case SAMPLE_S16:
+	  convert_s16(tmp, (const int16_t*)src, n); break;
+	case SAMPLE_S24:
+	  convert_s32(tmp, (const int32_t*)src, n, 24); break;
+	case SAMPLE_S32:
+	  convert_s32(tmp, (const int32_t*)src, n, 32); break;
+	default:
+	  memmove(tmp, src, n * sizeof(float));
+	}
+
+  if(channels == 1)
+	for(i = 0; i < frames; i++)
+	  dst[2 * i] = dst[2 * i + 1] = tmp[i];
+  else if(channels > 2)
+	for(i = 0; i < frames; i++)
+	  {
+		dst[2 * i] = tmp[channels * i];
+		dst[2 * i + 1] = tmp[channels * i + 1];
+	  }
+}
+
+#define DB_TABLE_BITS 8
+#define METER_FLOOR_DB -90.f
+
+// 20 log10 of the mantissas in [0.5, 1), see lin_to_db()
+static float db_table[(1 << DB_TABLE_BITS) + 1];
+
+/* dBFS of a linear level, x = m 2^e gives 20 log10(m) from the
+   table plus e times 20 log10(2), with no log at all */
+float
+lin_to_db(float x)
+{
+  float m, f;
+  int e, i;
+
+  if(x <= 0)
+	return METER_FLOOR_DB;
+
+  m = frexpf(x, &e);
+  f = (m - .5f) * (2 << DB_TABLE_BITS);
+  i = f;
+  f -= i;
+
+  m = db_table[i] + f * (db_table[i + 1] - db_table[i]);
+  m += e * 6.0206f;
+
+  return m > METER_FLOOR_DB ? m : METER_FLOOR_DB;
+}
+
+/* the sample peaks and the rms of n stereo frames, plain C,
+   as a reference of the SSE kernel */
+void
+levels_scalar(const float *frames, int n, struct Levels *lv)
+{
+  float sum[2] = {0, 0}, peak[2] = {0, 0}, x;
+  int i, c;
+
+  for(i = 0; i < n; i++)
+	for(c = 0; c < 2; c++)
+	  {
+		x = frames[2 * i + c];
+		sum[c] += x * x;
+		if(fabsf(x) > peak[c])
+		  peak[c] = fabsf(x);
+	  }
+
+  for(c = 0; c < 2; c++)
+	{
+	  lv->rms[c] = n > 0 ? sqrtf(sum[c] / n) : 0;
+	  lv->peak[c] = lv->true_peak[c] = peak[c];
+	}
+}
+
+/* one pass over the frames for the sums of squares and the
+   peaks of both channels, a register holds two stereo frames.
+   the channels are kept apart on the way for the true peak.
+   n is at most METER_MAX_FRAMES */
+void
+stereo_levels(struct Meter *m, const float *frames, int n, struct Levels *lv)
+{
+  int i = 0, c;
+#ifdef __SSE2__
+  const __m128 sign = _mm_set1_ps(-0.f);
+  __m128 sum = _mm_setzero_ps(), peak = _mm_setzero_ps(), x, y;
+  float s[4], p[4];
+
+  for(; i + 4 <= n; i += 4)
+	{
+	  x = _mm_loadu_ps(frames + 2 * i);     // l0 r0 l1 r1
+	  y = _mm_loadu_ps(frames + 2 * i + 4); // l2 r2 l3 r3
+	  sum = _mm_add_ps(sum, _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+	  peak = _mm_max_ps(peak, _mm_max_ps(_mm_andnot_ps(sign, x),
+										 _mm_andnot_ps(sign, y)));
+	  _mm_storeu_ps(m->chan[0] + i, _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0)));
+	  _mm_storeu_ps(m->chan[1] + i, _mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+
+  _mm_storeu_ps(s, sum);
+  _mm_storeu_ps(p, peak);
+  for(c = 0; c < 2; c++)
+	{
+	  lv->rms[c] = s[c] + s[c + 2];
+	  lv->peak[c] = p[c] > p[c + 2] ? p[c] : p[c + 2];
+	}
+#else
+  for(c = 0; c < 2; c++)
+	lv->rms[c] = lv->peak[c] = 0;
+#endif
+
+  for(; i < n; i++)
+	for(c = 0; c < 2; c++)
+	  {
+		m->chan[c][i] = frames[2 * i + c];
+		lv->rms[c] += m->chan[c][i] * m->chan[c][i];
+		if(fabsf(m->chan[c][i]) > lv->peak[c])
+		  lv->peak[c] = fabsf(m->chan[c][i]);
+	  }
+
+  for(c = 0; c < 2; c++)
+	lv->rms[c] = n > 0 ? sqrtf(lv->rms[c] / n) : 0;
+}
+
+/* peak of a channel oversampled by the polyphase filter, each
+   phase is a short FIR run over four outputs at a time */
+static float
+true_peak(struct Meter *m, const float *x, int n)
+{
+  float peak = 0, y;
+  int q, i, k;
+#ifdef __SSE2__
+  const __m128 sign = _mm_set1_ps(-0.f);
+  __m128 acc, vpeak = _mm_setzero_ps();
+  float p[4];
+#endif
+
+  for(q = 0; q < METER_OVERSAMPLE; q++)
+	{
+	  const float *h = m->taps[q];
+	  i = METER_TAPS - 1;
+#ifdef __SSE2__
+	  // four blocks at once, their sums don't wait on each other
+	  for(; i + 16 <= n; i += 16)
+		{
+		  __m128 a0 = _mm_setzero_ps(), a1 = a0, a2 = a0, a3 = a0, w;
+		  for(k = 0; k < METER_TAPS; k++)
+			{
+			  w = _mm_set1_ps(h[k]);
+			  a0 = _mm_add_ps(a0, _mm_mul_ps(w, _mm_loadu_ps(x + i - k)));
+			  a1 = _mm_add_ps(a1, _mm_mul_ps(w, _mm_loadu_ps(x + i + 4 - k)));
+			  a2 = _mm_add_ps(a2, _mm_mul_ps(w, _mm_loadu_ps(x + i + 8 - k)));
+			  a3 = _mm_add_ps(a3, _mm_mul_ps(w, _mm_loadu_ps(x + i + 12 - k)));
+			}
+		  a0 = _mm_max_ps(_mm_andnot_ps(sign, a0), _mm_andnot_ps(sign, a1));
+		  a2 = _mm_max_ps(_mm_andnot_ps(sign, a2), _mm_andnot_ps(sign, a3));
+		  vpeak = _mm_max_ps(vpeak, _mm_max_ps(a0, a2));
+		}
+	  for(; i + 4 <= n; i += 4)
+		{
+		  acc = _mm_setzero_ps();
+		  for(k = 0; k < METER_TAPS; k++)
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(h[k]),
+											 _mm_loadu_ps(x + i - k)));
+		  vpeak = _mm_max_ps(vpeak, _mm_andnot_ps(sign, acc));
+		}
+#endif
+	  for(; i < n; i++)
+		{
+		  for(y = 0, k = 0; k < METER_TAPS; k++)
+			y += h[k] * x[i - k];
+		  if(fabsf(y) > peak)
+			peak = fabsf(y);
+		}
+	}
+
+#ifdef __SSE2__
+  _mm_storeu_ps(p, vpeak);
+  for(k = 0; k < 4; k++)
+	if(p[k] > peak)
+	  peak = p[k];
+#endif
+
+  return peak;
+}
+
+void
+meter_measure(struct Meter *m, const float *frames, int n, struct Levels *lv)
+{
+  int c;
+
+  if(n > METER_MAX_FRAMES)
+	{
+	  frames += 2 * (n - METER_MAX_FRAMES); // the latest of them
+	  n = METER_MAX_FRAMES;
+	}
+
+  stereo_levels(m, frames, n, lv);
+
+  for(c = 0; c < 2; c++)
+	{
+	  lv->true_peak[c] = true_peak(m, m->chan[c], n);
+	  if(lv->peak[c] > lv->true_peak[c])
+		lv->true_peak[c] = lv->peak[c];
+	}
+}
+
+void
+meter_update(struct Meter *m, const struct Levels *lv, float dt)
+{
+  const float vu_k = 1.f - expf(-dt / .0651f);  // 1 - e^(-300/65.1) = 99%
+  const float ppm_k = 1.f - expf(-dt / .00451f); // 1 - e^(-10/4.51) = -1 dB
+  const float fall = expf(-20.f / 1.5f * dt * M_LN10 / 20.f);
+  int c;
+
+  for(c = 0; c < 2; c++)
+	{
+	  m->vu_lin[c] += (lv->rms[c] - m->vu_lin[c]) * vu_k;
+
+	  if(lv->true_peak[c] > m->ppm_lin[c])
+		m->ppm_lin[c] += (lv->true_peak[c] - m->ppm_lin[c]) * ppm_k;
+	  else if(m->ppm_lin[c] * fall > lv->true_peak[c])
+		m->ppm_lin[c] *= fall;
+	  else
+		m->ppm_lin[c] = lv->true_peak[c];
+
+	  m->vu[c] = lin_to_db(m->vu_lin[c]);
+	  m->ppm[c] = lin_to_db(m->ppm_lin[c]);
+	}
+}
+
+struct Meter *
+meter_setup(void)
+{
+  struct Meter *m = (struct Meter*) malloc(sizeof(struct Meter));
+  const int size = METER_TAPS * METER_OVERSAMPLE;
+  const float center = (size - 1) / 2.f;
+  float t, sum;
+  int i, k, q;
+
+  for(i = 0; i <= 1 << DB_TABLE_BITS; i++)
+	db_table[i] = 20.f * log10f(.5f + .5f * i / (1 << DB_TABLE_BITS));
+
+  /* windowed sinc interpolating by 4, phase q takes the taps
+	 q, q + 4, q + 8... each phase is brought to unit gain */
+  for(q = 0; q < METER_OVERSAMPLE; q++)
+	{
+	  for(sum = 0, k = 0; k < METER_TAPS; k++)
+		{
+		  i = q + k * METER_OVERSAMPLE;
+		  t = (i - center) / METER_OVERSAMPLE;
+		  m->taps[q][k] = (t == 0 ? 1.f : sinf(M_PI * t) / (M_PI * t))
+			* (.5f - .5f * cosf(2.f * M_PI * (i + .5f) / size));
+		  sum += m->taps[q][k];
+		}
+	  for(k = 0; k < METER_TAPS; k++)
+		m->taps[q][k] /= sum;
+	}
+
+  for(i = 0; i < 2; i++)
+	{
+	  m->vu_lin[i] = m->ppm_lin[i] = 0;
+	  m->vu[i] = m->ppm[i] = METER_FLOOR_DB;
+	}
+
+  return m;
+}
+
+void
+meter_free(struct Meter *m)
+{
+  free(m);
+}
+
+struct Spectrum *
+spectrum_setup(int size)
+{
+  struct Spectrum *sp =
+	(struct Spectrum*) malloc(sizeof(struct Spectrum));
+  const int half = size / 2;
+  int i, j, h, bits, r;
+
+  sp->size = size;
+  sp->half = half;
+
+  sp->rev = (int*) malloc(half * sizeof(int));
+  sp->window = (float*) malloc(size * sizeof(float));
+  sp->tw_re = (float*) malloc(half * sizeof(float));
+  sp->tw_im = (float*) malloc(half * sizeof(float));
+  sp->sp_re = (float*) malloc((half + 1) * sizeof(float));
+  sp->sp_im = (float*) malloc((half + 1) * sizeof(float));
+  sp->re = (float*) malloc(half * sizeof(float));
+  sp->im = (float*) malloc(half * sizeof(float));
+  sp->power = (float*) malloc((half + 1) * sizeof(float));
+
+  for(bits = 0; (1 << bits) < half; bits++);
+  for(i = 0; i < half; i++)
+	{
+	  for(j = r = 0; j < bits; j++)
+		r |= ((i >> j) & 1) << (bits - 1 - j);
+	  sp->rev[i] = r;
+	}
+
+  for(i = 0; i < size; i++)
+	sp->window[i] = .5f - .5f * cosf(2.f * M_PI * i / (size - 1));
+
+  /* a stage joining transforms of h points takes h twiddles,
+	 they start at h - 1 in the table */
+  for(h = 1; h < half; h *= 2)
+	for(j = 0; j < h; j++)
+	  {
+		sp->tw_re[h - 1 + j] = cosf(M_PI * j / h);
+		sp->tw_im[h - 1 + j] = -sinf(M_PI * j / h);
+	  }
+
+  for(i = 0; i <= half; i++)
+	{
+	  sp->sp_re[i] = cosf(2.f * M_PI * i / size);
+	  sp->sp_im[i] = -sinf(2.f * M_PI * i / size);
+	}
+
+  sp->rate = 0;
+  sp->nbands = 0;
+  memset(sp->level, 0, sizeof(sp->level));
+  memset(sp->peak, 0, sizeof(sp->peak));
+  memset(sp->hold, 0, sizeof(sp->hold));
+
+  return sp;
+}
+
+void
+spectrum_free(struct Spectrum *sp)
+{
+  free(sp->rev);
+  free(sp->window);
+  free(sp->tw_re);
+  free(sp->tw_im);
+  free(sp->sp_re);
+  free(sp->sp_im);
+  free(sp->re);
+  free(sp->im);
+  free(sp->power);
+  free(sp);
+}
+
+/* bands spaced evenly in log frequency, each has one bin at
+   least, so the lowest ones get wider than asked */
+void
+spectrum_set_bands(struct Spectrum *sp, int nbands, float rate)
+{
+  const float high = SPECTRUM_HIGH_HZ < rate / 2 ? SPECTRUM_HIGH_HZ : rate / 2;
+  const float ratio = high / SPECTRUM_LOW_HZ;
+  int b, bin;
+
+  if(nbands > SPECTRUM_MAX_BANDS)
+	nbands = SPECTRUM_MAX_BANDS;
+
+  for(b = 0; b <= nbands; b++)
+	{
+	  bin = SPECTRUM_LOW_HZ * powf(ratio, (float)b / nbands)
+		* sp->size / rate + .5f;
+	  if(b > 0 && bin <= sp->edge[b - 1])
+		bin = sp->edge[b - 1] + 1;
+	  sp->edge[b] = bin < sp->half ? bin : sp->half;
+	}
+
+  sp->nbands = nbands;
+  sp->rate = rate;
+}
+
+static void
+butterflies(struct Spectrum *sp)
+{
+  float *restrict re = sp->re, *restrict im = sp->im;
+  const float *wr, *wi;
+  const int n = sp->half;
+  float tr, ti;
+  int h, k, j, a, b;
+
+  for(h = 1; h < n; h *= 2)
+	{
+	  wr = sp->tw_re + h - 1;
+	  wi = sp->tw_im + h - 1;
+
+	  for(k = 0; k < n; k += 2 * h)
+		{
+		  j = 0;
+#ifdef __SSE2__
+		  for(; j + 4 <= h; j += 4)
+			{
+			  a = k + j, b = a + h;
+			  __m128 xr = _mm_loadu_ps(re + b), xi = _mm_loadu_ps(im + b);
+			  __m128 vr = _mm_loadu_ps(wr + j), vi = _mm_loadu_ps(wi + j);
+			  __m128 yr = _mm_sub_ps(_mm_mul_ps(xr, vr), _mm_mul_ps(xi, vi));
+			  __m128 yi = _mm_add_ps(_mm_mul_ps(xr, vi), _mm_mul_ps(xi, vr));
+			  __m128 ur = _mm_loadu_ps(re + a), ui = _mm_loadu_ps(im + a);
+			  _mm_storeu_ps(re + b, _mm_sub_ps(ur, yr));
+			  _mm_storeu_ps(im + b, _mm_sub_ps(ui, yi));
+			  _mm_storeu_ps(re + a, _mm_add_ps(ur, yr));
+			  _mm_storeu_ps(im + a, _mm_add_ps(ui, yi));
+			}
+#endif
+		  for(; j < h; j++)
+			{
+			  a = k + j, b = a + h;
+			  tr = re[b] * wr[j] - im[b] * wi[j];
+			  ti = re[b] * wi[j] + im[b] * wr[j];
+			  re[b] = re[a] - tr;
+			  im[b] = im[a] - ti;
+			  re[a] += tr;
+			  im[a] += ti;
+			}
+		}
+	}
+}
+
+/* power of each bin for the last size stereo frames. the real
+   input is packed as half as many complex points, the even
+   samples being the real parts, and split back afterwards */
+static void
+real_transform(struct Spectrum *sp, const float *frames)
+{
+  const float scale = .5f; // mono mix
+  const int n = sp->half;
+  float x0, x1, er, ei, or, oi, p, q;
+  int i, k;
+
+  for(i = 0; i < n; i++)
+	{
+	  x0 = (frames[4 * i] + frames[4 * i + 1]) * scale;
+	  x1 = (frames[4 * i + 2] + frames[4 * i + 3]) * scale;
+	  sp->re[sp->rev[i]] = x0 * sp->window[2 * i];
+	  sp->im[sp->rev[i]] = x1 * sp->window[2 * i + 1];
+	}
+
+  butterflies(sp);
+
+  for(k = 0; k <= n; k++)
+	{
+	  const int a = k < n ? k : 0, c = k > 0 ? n - k : 0;
+	  er = .5f * (sp->re[a] + sp->re[c]);
+	  ei = .5f * (sp->im[a] - sp->im[c]);
+	  or = .5f * (sp->re[a] - sp->re[c]);
+	  oi = .5f * (sp->im[a] + sp->im[c]);
+	  p = sp->sp_re[k] * or - sp->sp_im[k] * oi;
+	  q = sp->sp_re[k] * oi + sp->sp_im[k] * or;
+	  sp->power[k] = (er + q) * (er + q) + (ei - p) * (ei - p);
+	}
+}
+
+/* dt is the time since the last call, the levels fall and the
+   peaks are held by it rather than by the frame count */
+void
+spectrum_analyze(struct Spectrum *sp, const float *frames, float dt)
+{
+  // a full scale sine through the hann window peaks at size / 4
+  const float full = (float)sp->size * sp->size / 16.f;
+  float sum, db, value;
+  int b, k;
+
+  real_transform(sp, frames);
+
+  for(b = 0; b < sp->nbands; b++)
+	{
+	  for(sum = 0, k = sp->edge[b]; k < sp->edge[b + 1]; k++)
+		sum += sp->power[k];
+
+	  db = 10.f * log10f(sum / full + 1e-12f);
+	  value = 1.f - db / SPECTRUM_FLOOR_DB;
+	  value = value < 0 ? 0 : value > 1 ? 1 : value;
+
+	  if(value >= sp->level[b])
+		sp->level[b] = value;
+	  else if(sp->level[b] - LEVEL_FALL * dt > value)
+		sp->level[b] -= LEVEL_FALL * dt;
+	  else
+		sp->level[b] = value;
+
+	  if(sp->level[b] >= sp->peak[b])
+		{
+		  sp->peak[b] = sp->level[b];
+		  sp->hold[b] = PEAK_HOLD;
+		}
+	  else if(sp->hold[b] > 0)
+		sp->hold[b] -= dt;
+	  else if((sp->peak[b] -= PEAK_FALL * dt) < sp->level[b])
+		sp->peak[b] = sp->level[b];
+	}
+}
@@ -0,0 +1,86 @@
+#include <stdint.h>
+
+#ifndef XKCJVHBNWQERTYUIOPAS
+#define XKCJVHBNWQERTYUIOPAS
+
+#define SPECTRUM_SIZE 2048 // points of the transform
+#define SPECTRUM_MAX_BANDS 128
+
+/* everything a spectrum needs, the tables are worked out once
+ * in spectrum_setup() so a frame only runs the butterflies.
+ * the complex arrays are kept split (real and imaginary parts
+ * apart) so a butterfly stage runs four of them at a time */
+struct Spectrum
+{
+  int size;              // a power of two
+  int half;              // points of the complex transform run
+  int *rev;              // bit reversal of the half transform
+  float *window;         // hann
+  float *tw_re, *tw_im;  // twiddles of the stages, one after another
+  float *sp_re, *sp_im;  // twiddles splitting the real spectrum
+  float *re, *im;        // work buffers
+  float *power;          // per bin, half + 1 of them
+
+  float rate;            // sample rate the bands are laid out for
+  int nbands;
+  int edge[SPECTRUM_MAX_BANDS + 1]; // first bin of each band
+  float level[SPECTRUM_MAX_BANDS];  // 0 to 1, what is shown
+  float peak[SPECTRUM_MAX_BANDS];
+  float hold[SPECTRUM_MAX_BANDS];   // seconds the peak still holds
+};
+
+// how samples come from the mpd fifo, "bits" of its format
+enum sample_format
+  {
+	SAMPLE_S16,
+	SAMPLE_S24, // 24 bits in the low end of 32
+	SAMPLE_S32,
+	SAMPLE_F32
+  };
+
+int  sample_bytes(int format);
+void sample_convert(float *dst, const void *src, int frames,
+					int format, int channels);
+
+#define METER_TAPS 8 // of each phase of the true peak filter
+#define METER_OVERSAMPLE 4
+#define METER_MAX_FRAMES 4096 // measured at a time
+
+// what a block of stereo frames measures, linear, full scale 1
+struct Levels
+{
+  float rms[2];
+  float peak[2];      // of the samples
+  float true_peak[2]; // between them too, 4x oversampled
+};
+
+/* stereo meter. the VU needle gets to 99% of the rms in 300
+ * ms. the PPM follows the true peak as the DIN one (IEC 60268-10
+ * type I) does: a 10 ms burst reads 1 dB under, it falls back by
+ * 20 dB in 1.5 s. vu and ppm are in dBFS */
+struct Meter
+{
+  float taps[METER_OVERSAMPLE][METER_TAPS]; // polyphase, by phase
+  float chan[2][METER_MAX_FRAMES]; // the channels apart
+  float vu_lin[2];
+  float ppm_lin[2];
+  float vu[2];
+  float ppm[2];
+};
+
+float lin_to_db(float x);
+void  levels_scalar(const float *frames, int n, struct Levels *lv);
+void  stereo_levels(struct Meter *m, const float *frames, int n,
+					struct Levels *lv);
+void  meter_measure(struct Meter *m, const float *frames, int n,
+					struct Levels *lv);
+void  meter_update(struct Meter *m, const struct Levels *lv, float dt);
+struct Meter *meter_setup(void);
+void  meter_free(struct Meter *m);
+
+struct Spectrum *spectrum_setup(int size);
+void spectrum_free(struct Spectrum *sp);
+void spectrum_set_bands(struct Spectrum *sp, int nbands, float rate);
+void spectrum_analyze(struct Spectrum *sp, const float *frames, float dt);
+
+#endif
@@ -0,0 +1,125 @@
+#include "format.h"
+#include "text.h"
+
+static const char *field_names[FIELD_NUM] =
+  {
+	NULL, "pos", "title", "artist", "album", "time"
+  };
+
+// natural width of the fields having one
+static const int field_widths[FIELD_NUM] = {0, 5, 0, 0, 0, 5};
+
+static int
+add_literal(struct RowFormat *fmt, const char *text, int len)
+{
+  struct FormatOp *op;
+
+  if(len == 0)
+	return 0;
+
+  if(fmt->size >= MAX_FORMAT_OPS
+	 || fmt->literals_len + len + 1 > (int)sizeof(fmt->literals))
+	return -1;
+
+  op = fmt->ops + fmt->size++;
+  op->field = FIELD_LITERAL;
+  op->literal = fmt->literals_len;
+  op->width = utf8_width(text, len);
+
+  memcpy(fmt->literals + fmt->literals_len, text, len);
+  fmt->literals_len += len;
+  fmt->literals[fmt->literals_len++] = '\0';
+
+  return 0;
+}
+
+/* "%name" inserts a field, "%name|N" limits it to N columns,
+   "%%" is a percent sign and the rest is taken literally.
+   returns 0 on success, -1 if the template is malformed */
+int
+row_format_compile(struct RowFormat *fmt, const char *source)
+{
+  const char *pt = source, *begin = source;
+  struct FormatOp *op;
+  int i, len;
+
+  fmt->size = 0;
+  fmt->literals_len = 0;
+  fmt->layout_width = -1;
+
+  while(*pt)
+	{
+	  if(*pt != '%')
+		{
+		  pt++;
+		  continue;
+		}
+
+	  if(add_literal(fmt, begin, pt - begin) < 0)
+		return -1;
+
+	  if(pt[1] == '%')
+		{
+		  begin = pt + 1; // taken with the next literal
+		  pt += 2;
+		  continue;
+		}
+
+	  for(len = 0; isalpha(pt[1 + len]); len++);
+
+	  for(i = 1; i < FIELD_NUM; i++)
+		if((int)strlen(field_names[i]) == len
+		   && strncmp(field_names[i], pt + 1, len) == 0)
+		  break;
+
+	  if(i == FIELD_NUM || fmt->size >= MAX_FORMAT_OPS)
+		return -1;
+
+	  op = fmt->ops + fmt->size++;
+	  op->field = i;
+	  op->width = field_widths[i];
+	  pt += 1 + len;
+
+	  if(*pt == '|' && isdigit(pt[1]))
+		op->width = (int)strtol(pt + 1, (char**)&pt, 10);
+
+	  begin = pt;
+	}
+
+  return add_literal(fmt, begin, pt - begin);
+}
+
+/* give every op its columns, the fields without a width share
+   what the others leave */
+void
+row_format_layout(struct RowFormat *fmt, int width)
+{
+  int i, fixed = 0, flex = 0, rest;
+  struct FormatOp *op;
+
+  if(fmt->layout_width == width)
+	return;
+
+  for(i = 0; i < fmt->size; i++)
+	{
+	  fixed += fmt->ops[i].width;
+	  flex += fmt->ops[i].field != FIELD_LITERAL && fmt->ops[i].width == 0;
+	}
+
+  rest = width > fixed ? width - fixed : 0;
+
+  for(i = 0; i < fmt->size; i++)
+	{
+	  op = fmt->ops + i;
+	  if(op->width > 0 || op->field == FIELD_LITERAL)
+		op->cols = op->width;
+	  else
+		{
+		  op->cols = rest / flex;
+		  rest -= op->cols;
+		  flex--;
+		}
+	}
+
+  fmt->layout_width = width;
+}
@@ -0,0 +1,53 @@
+#include "global.h"
+#include "text.h"
+
+#ifndef ZMXNCBVQPWOEIRUTY
+#define ZMXNCBVQPWOEIRUTY
+
+#define MAX_FORMAT_OPS 32
+
+// what a list row may show, see row_format_compile()
+enum format_field
+  {
+	FIELD_LITERAL,           // text between the fields
+	FIELD_POS,               // position in the list
+	FIELD_TITLE,
+	FIELD_ARTIST,
+	FIELD_ALBUM,
+	FIELD_TIME,              // duration, mm:ss
+	FIELD_NUM
+  };
+
+struct FormatOp
+{
+  int field;
+  int width;   // |N in the template, 0 for sharing the rest of the row
+  int cols;    // columns given by the last layout
+  int literal; // offset in RowFormat.literals, FIELD_LITERAL only
+};
+
+/* a row template such as "%pos %title|40 %artist|20 %album %time"
+ * is compiled once into the ops, rendering a row is then only a
+ * walk through them */
+struct RowFormat
+{
+  struct FormatOp ops[MAX_FORMAT_OPS];
+  int size;
+
+  char literals[256]; // nul separated texts of the literal ops
+  int literals_len;
+
+  int layout_width; // row width the columns were laid out for
+};
+
+// what fills a field of a row
+struct FieldText
+{
+  const char *str;
+  const struct TextInfo *info; // NULL for a string not measured
+};
+
+int  row_format_compile(struct RowFormat *fmt, const char *source);
+void row_format_layout(struct RowFormat *fmt, int width);
+
+#endif
@@ -1,10 +1,14 @@
+#define _GNU_SOURCE // wcwidth(), get_wch() and friends
 #include <mpd/client.h>
 
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <wchar.h>
+#include <wctype.h>
 #include <ncursesw/ncurses.h>
 #include <locale.h>
 #include <math.h>
@@ -13,6 +17,12 @@
 #include <dirent.h> 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <errno.h>
 
 #ifndef LKJSDFAOIJCSAF
 #define LKJSDFAOIJCSAF
@@ -23,7 +33,6 @@
 #define INTERVAL_MAX_UNIT 200000
 #define INTERVAL_INCREMENT 800
 #define MAX_SONGLIST_STORE_LENGTH 700
-#define BUFFER_SIZE 32
 
 int quit_signal;
 // 1 for the minimum interval, 0 for dynamic (increase),
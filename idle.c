@@ -0,0 +1,123 @@
+#include "idle.h"
+#include "utils.h"
+
+static void
+idle_dispatch(enum mpd_idle events)
+{
+  int i;
+
+  for(i = 0; i < idle->nlistener; i++)
+	if(events & idle->listener[i].mask)
+	  idle->listener[i].on_event(events & idle->listener[i].mask);
+}
+
+/* the connection broke: stop watching it and tell everyone that
+   all they wait for may have changed, since from now on nobody
+   will know. they are to stop trusting their caches by
+   idle_alive() */
+static void
+idle_lost(void)
+{
+  unwatch_fd(mpd_connection_get_fd(idle->conn));
+  mpd_connection_free(idle->conn);
+  idle->conn = NULL;
+
+  idle_dispatch(idle->mask);
+}
+
+static void
+idle_wait(void)
+{
+  if(idle->conn && idle->mask && !mpd_send_idle_mask(idle->conn, idle->mask))
+	idle_lost();
+}
+
+// the idle socket is readable: mpd reports what changed
+static void
+idle_on_ready(void)
+{
+  enum mpd_idle events = mpd_recv_idle(idle->conn, false);
+
+  if(!mpd_response_finish(idle->conn))
+	{
+	  idle_lost();
+	  return;
+	}
+
+  idle_dispatch(events);
+  idle_wait();
+}
+
+/* have on_event called with the events of mask that happen.
+   while parked mpd takes nothing but "noidle", so the wait is
+   cut to add the new mask, what it had collected is passed on */
+void
+idle_listen(enum mpd_idle mask, void (*on_event)(enum mpd_idle events))
+{
+  enum mpd_idle events;
+
+  if(idle->nlistener >= MAX_IDLE_LISTENERS)
+	return;
+
+  idle->listener[idle->nlistener].mask = mask;
+  idle->listener[idle->nlistener].on_event = on_event;
+  idle->nlistener++;
+
+  if(idle->conn == NULL)
+	return;
+
+  if(idle->mask)
+	{
+	  if(!mpd_send_noidle(idle->conn))
+		{
+		  idle_lost();
+		  return;
+		}
+	  events = mpd_recv_idle(idle->conn, false);
+	  if(!mpd_response_finish(idle->conn))
+		{
+		  idle_lost();
+		  return;
+		}
+	  idle_dispatch(events);
+	}
+
+  idle->mask |= mask;
+  idle_wait();
+}
+
+// whether changes are still being heard of
+int
+idle_alive(void)
+{
+  return idle->conn != NULL;
+}
+
+struct Idle *idle_setup(void)
+{
+  struct Idle *idl =
+	(struct Idle*) calloc(1, sizeof(struct Idle));
+
+  // not fatal, the client only loses its change notifications
+  idl->conn = mpd_connection_new(NULL, 0, 0);
+  if(idl->conn && mpd_connection_get_error(idl->conn) != MPD_ERROR_SUCCESS)
+	{
+	  mpd_connection_free(idl->conn);
+	  idl->conn = NULL;
+	}
+
+  if(idl->conn)
+	watch_fd(mpd_connection_get_fd(idl->conn), idle_on_ready);
+
+  return idl;
+}
+
+void idle_free(struct Idle *idl)
+{
+  if(idl->conn)
+	{
+	  unwatch_fd(mpd_connection_get_fd(idl->conn));
+	  mpd_connection_free(idl->conn);
+	}
+  free(idl);
+}
@@ -0,0 +1,32 @@
+#include "global.h"
+
+#ifndef PLOKIJUHYGTFRDESWAQZ
+#define PLOKIJUHYGTFRDESWAQZ
+
+#define MAX_IDLE_LISTENERS 8
+
+/* a second connection parked in mpd's "idle" command, so that
+ * changes to the server are learned without polling. its socket
+ * is one of the fds the main loop sleeps on (see watch_fd()) */
+struct Idle
+{
+  struct mpd_connection *conn; // NULL once it's lost
+  enum mpd_idle mask; // the union of what the listeners want
+
+  int nlistener;
+  struct
+  {
+	enum mpd_idle mask;
+	void (*on_event)(enum mpd_idle events);
+  } listener[MAX_IDLE_LISTENERS];
+};
+
+struct Idle *idle;
+
+void idle_listen(enum mpd_idle mask, void (*on_event)(enum mpd_idle events));
+int  idle_alive(void);
+
+struct Idle *idle_setup(void);
+void idle_free(struct Idle *idl);
+
+#endif
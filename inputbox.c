@@ -0,0 +1,229 @@
+#include "inputbox.h"
+#include "utils.h"
+#include "keyboards.h"
+
+void
+inputbox_open(const char *prompt, void (*on_finish)(const char *text))
+{
+  snprintf(inputbox->prompt, sizeof(inputbox->prompt), "%s", prompt);
+  inputbox->buff[0] = '\0';
+  inputbox->length = inputbox->cursor = 0;
+  inputbox->on_finish = on_finish;
+
+  // take over the keyboard, all the other routines go on as usual
+  inputbox->saved_keyboard = being_mode->listen_keyboard;
+  being_mode->listen_keyboard = &inputbox_keymap;
+
+  wchain[INPUT_BOX].visible = 1;
+  signal_win(INPUT_BOX);
+}
+
+void
+inputbox_close(void)
+{
+  being_mode->listen_keyboard = inputbox->saved_keyboard;
+
+  wchain[INPUT_BOX].visible = 0;
+  clean_window(INPUT_BOX);
+
+  // windows beneath the box need to be repainted
+  signal_all_wins();
+}
+
+void
+inputbox_finish(void)
+{
+  void (*on_finish)(const char *text) = inputbox->on_finish;
+
+  inputbox_close();
+
+  if(on_finish)
+	on_finish(inputbox->buff);
+}
+
+void
+inputbox_insert(wchar_t wc)
+{
+  char mb[MB_LEN_MAX];
+  mbstate_t state;
+  size_t n;
+
+  memset(&state, 0, sizeof(state));
+  n = wcrtomb(mb, wc, &state);
+
+  if(n == (size_t)-1 || inputbox->length + (int)n >= (int)sizeof(inputbox->buff))
+	return;
+
+  char *pt = inputbox->buff + inputbox->cursor;
+  memmove(pt + n, pt, inputbox->length - inputbox->cursor + 1);
+  memcpy(pt, mb, n);
+
+  inputbox->length += n;
+  inputbox->cursor += n;
+}
+
+/* step over the continuation bytes (10xxxxxx) of utf-8 */
+static int
+prev_char_offset(int offset)
+{
+  const char *buff = inputbox->buff;
+
+  if(offset <= 0)
+	return 0;
+
+  do offset--;
+  while(offset > 0 && (buff[offset] & 0xC0) == 0x80);
+
+  return offset;
+}
+
+static int
+next_char_offset(int offset)
+{
+  const char *buff = inputbox->buff;
+
+  if(offset >= inputbox->length)
+	return inputbox->length;
+
+  do offset++;
+  while(offset < inputbox->length && (buff[offset] & 0xC0) == 0x80);
+
+  return offset;
+}
+
+static void
+delete_range(int from, int to)
+{
+  char *buff = inputbox->buff;
+
+  memmove(buff + from, buff + to, inputbox->length - to + 1);
+  inputbox->length -= to - from;
+}
+
+void
+inputbox_delete_backward(void)
+{
+  int from = prev_char_offset(inputbox->cursor);
+
+  delete_range(from, inputbox->cursor);
+  inputbox->cursor = from;
+}
+
+void
+inputbox_delete_forward(void)
+{
+  delete_range(inputbox->cursor, next_char_offset(inputbox->cursor));
+}
+
+void
+inputbox_kill_line(void)
+{
+  delete_range(0, inputbox->cursor);
+  inputbox->cursor = 0;
+}
+
+void
+inputbox_cursor_left(void)
+{
+  inputbox->cursor = prev_char_offset(inputbox->cursor);
+}
+
+void
+inputbox_cursor_right(void)
+{
+  inputbox->cursor = next_char_offset(inputbox->cursor);
+}
+
+void
+inputbox_cursor_home(void)
+{
+  inputbox->cursor = 0;
+}
+
+void
+inputbox_cursor_end(void)
+{
+  inputbox->cursor = inputbox->length;
+}
+
+void
+inputbox_redraw(void)
+{
+  WINDOW *win = specific_win(INPUT_BOX);
+  const int width = win->_maxx - 7; // columns for the text
+
+  const char *buff = inputbox->buff;
+  wchar_t wtext[sizeof(inputbox->buff)];
+  int cols[sizeof(inputbox->buff) + 1]; // display column of each char
+  int i, n, w, crt = -1, offset = 0, begin = 0;
+  mbstate_t state;
+  size_t len;
+
+  /* decode the buffer and measure the display columns, crt
+	 is the index of the character under the cursor */
+  memset(&state, 0, sizeof(state));
+  for(n = 0, cols[0] = 0; offset < inputbox->length; n++)
+	{
+	  if(offset == inputbox->cursor)
+		crt = n;
+
+	  len = mbrtowc(wtext + n, buff + offset,
+					inputbox->length - offset, &state);
+	  if(len == (size_t)-1 || len == (size_t)-2 || len == 0)
+		{
+		  wtext[n] = L'?';
+		  len = 1;
+		  memset(&state, 0, sizeof(state));
+		}
+
+	  w = wcwidth(wtext[n]);
+	  cols[n + 1] = cols[n] + (w > 0 ? w : 0);
+	  offset += len;
+	}
+  if(crt < 0)
+	crt = n;
+
+  // scroll horizontally to keep the cursor in sight
+  while(begin < crt && cols[crt] - cols[begin] + 1 > width)
+	begin++;
+
+  wborder(win, 0, 0, 0, 0, 0, 0, 0, 0);
+  mvwprintw(win, 2, 2, "%s", inputbox->prompt);
+  wmove(win, 4, 4);
+
+  for(i = begin; i < n && cols[i + 1] - cols[begin] <= width; i++)
+	{
+	  if(i == crt)
+		wattron(win, A_REVERSE);
+	  waddnwstr(win, wtext + i, 1);
+	  if(i == crt)
+		wattroff(win, A_REVERSE);
+	}
+
+  // the cursor is at the end of the text
+  if(crt == n)
+	{
+	  wattron(win, A_REVERSE);
+	  waddch(win, ' ');
+	  wattroff(win, A_REVERSE);
+	}
+}
+
+struct InputBox *inputbox_setup(void)
+{
+  struct InputBox *ibox =
+	(struct InputBox*) malloc(sizeof(struct InputBox));
+
+  ibox->prompt[0] = '\0';
+  ibox->buff[0] = '\0';
+  ibox->length = ibox->cursor = 0;
+  ibox->saved_keyboard = NULL;
+  ibox->on_finish = NULL;
+
+  return ibox;
+}
+
+void inputbox_free(struct InputBox *ibox)
+{
+  free(ibox);
+}
@@ -0,0 +1,41 @@
+#include "global.h"
+#include "windows.h"
+
+#ifndef QWOEIJFALKSDJFOQWIE
+#define QWOEIJFALKSDJFOQWIE
+
+/* a single line editor living in the INPUT_BOX window, it is fed
+ * by the main loop's key events (see inputbox_keymap()) so the
+ * rest of the client keeps running while the user is typing */
+struct InputBox
+{
+  char prompt[128];
+  char buff[512]; // editing buffer, utf-8 encoded
+  int length;     // bytes used in buff
+  int cursor;     // byte offset of the editing point
+
+  // keymap to restore when the editing is finished
+  void (*saved_keyboard)(void);
+  // invoked with the text on <Enter>, never on cancel
+  void (*on_finish)(const char *text);
+};
+
+struct InputBox *inputbox;
+
+void inputbox_open(const char *prompt, void (*on_finish)(const char *text));
+void inputbox_close(void);
+void inputbox_finish(void);
+void inputbox_insert(wchar_t wc);
+void inputbox_delete_backward(void);
+void inputbox_delete_forward(void);
+void inputbox_kill_line(void);
+void inputbox_cursor_left(void);
+void inputbox_cursor_right(void);
+void inputbox_cursor_home(void);
+void inputbox_cursor_end(void);
+void inputbox_redraw(void);
+
+struct InputBox *inputbox_setup(void);
+void inputbox_free(struct InputBox *ibox);
+
+#endif
@@ -4,8 +4,11 @@
 #include "songs.h"
 #include "directory.h"
 #include "playlists.h"
+#include "browser.h"
 #include "visualizer.h"
 #include "commands.h"
+#include "inputbox.h"
+#include "render.h"
 
 void fundamental_keymap_template(int key)
 {
@@ -43,6 +46,7 @@ void fundamental_keymap_template(int key)
 	  cmd_repeat(); break;
 	case 'L': // redraw screen
 	  clean_screen();
+	  render_invalidate();
 	  break;
 	case '/':
 	  turnon_search_mode();
@@ -67,9 +71,15 @@ void fundamental_keymap_template(int key)
 	case '4':
 	  switch_to_directory_menu();
 	  break;
+	case '5':
+	  switch_to_library_menu();
+	  break;
 	case 'v':
 	  toggle_visualizer();
 	  break;
+	case 'V':
+	  visualizer_next_mode();
+	  break;
 	case 27: ;
 	case 'e': ;
 	case 'q':
@@ -149,6 +159,7 @@ directory_keymap_template(int key)
 
 	case '\n':
 	  enter_selected_dir();break;
+	case KEY_BACKSPACE: // what most terminfo make of 127
 	case 127:
 	  if(exit_current_dir()) // if already in root dir
 		switch_to_prev_menu();;
@@ -158,6 +169,21 @@ directory_keymap_template(int key)
 	case 'c':
 	  songlist_clear();
 	  break;
+	case 'o': // order by name, time or size
+	  directory_cycle_sort();
+	  break;
+	case 'm':
+	  directory_toggle_mark();
+	  break;
+	case 'M': // mark up to the latest toggled
+	  directory_mark_range();
+	  break;
+	case 'C':
+	  directory_clear_marks();
+	  break;
+	case 'i': // songs by their tags
+	  directory_toggle_columns();
+	  break;
 	case 'r':
 	  replace_songlist();
 	  songlist_scroll_to(1);
@@ -244,6 +270,57 @@ playlist_keymap_template(int key)
 	}
 }
 
+void
+browser_keymap_template(int key)
+{
+  // filter those different with the template
+  switch(key)
+	{
+	case 'v': break; // key be masked
+
+	case '\n':
+	  browser_enter();
+	  break;
+	case KEY_BACKSPACE:
+	case 127:
+	  if(browser_exit()) // if already at the artists
+		switch_to_prev_menu();
+	  break;
+	case 'a':
+	  browser_append();
+	  break;
+	case 'c':
+	  songlist_clear();
+	  break;
+	case 'r':
+	  browser_replace();
+	  songlist_scroll_to(1);
+	  break;
+
+	case 14: ; // ctrl-n
+	case KEY_DOWN:;
+	case 'j':
+	  browser_scroll_down_line();break;
+	case 16: ; // ctrl-p
+	case KEY_UP:;
+	case 'k':
+	  browser_scroll_up_line();break;
+	case 'b':
+	  browser_scroll_up_page();break;
+	case ' ':
+	  browser_scroll_down_page();break;
+	case 'g':  // cursor goto the beginning
+	  browser_scroll_to(1);
+	  break;
+	case 'G':  // cursor goto the end
+	  browser_scroll_to(browser->length);
+	  break;
+
+	default:
+	  fundamental_keymap_template(key);
+	}
+}
+
 // for picking the song from the searchmode
 // corporate with searchmode_keymap()
 void
@@ -340,6 +417,7 @@ directory_keymap(void)
 	return;
 
   directory_keymap_template(key);
+  directory_prefetch_stop();
 
   signal_all_wins();  
 }
@@ -359,6 +437,21 @@ playlist_keymap(void)
   signal_all_wins();  
 }
 
+void
+browser_keymap(void)
+{
+  int key = getch();
+
+  if(key != ERR)
+	interval_level = 1;
+  else
+	return;
+
+  browser_keymap_template(key);
+
+  signal_all_wins();
+}
+
 // for getting the keyword
 void
 searchmode_keymap(void)
@@ -428,3 +521,68 @@ searchmode_keymap(void)
 	}
 }
 
+// for editing the text in the input box, keys come in
+// as wide characters so utf-8 input is handled properly
+void
+inputbox_keymap(void)
+{
+  wint_t key;
+  int ret = get_wch(&key);
+
+  if(ret != ERR)
+	interval_level = 1;
+  else
+	return;
+
+  if(ret == KEY_CODE_YES)
+	{
+	  switch(key)
+		{
+		case KEY_LEFT:
+		  inputbox_cursor_left(); break;
+		case KEY_RIGHT:
+		  inputbox_cursor_right(); break;
+		case KEY_HOME:
+		  inputbox_cursor_home(); break;
+		case KEY_END:
+		  inputbox_cursor_end(); break;
+		case KEY_BACKSPACE:
+		  inputbox_delete_backward(); break;
+		case KEY_DC:
+		  inputbox_delete_forward(); break;
+		case KEY_ENTER:
+		  inputbox_finish(); return;
+		default:;
+		}
+	}
+  else
+	{
+	  switch(key)
+		{
+		case '\n':
+		  inputbox_finish(); return;
+		case 27:
+		  inputbox_close(); return;
+		case 127: ;
+		case 8: // ctrl-h
+		  inputbox_delete_backward(); break;
+		case 4: // ctrl-d
+		  inputbox_delete_forward(); break;
+		case 1: // ctrl-a
+		  inputbox_cursor_home(); break;
+		case 5: // ctrl-e
+		  inputbox_cursor_end(); break;
+		case 2: // ctrl-b
+		  inputbox_cursor_left(); break;
+		case 6: // ctrl-f
+		  inputbox_cursor_right(); break;
+		case 21: // ctrl-u
+		  inputbox_kill_line(); break;
+		default:
+		  if(iswprint(key))
+			inputbox_insert((wchar_t)key);
+		}
+	}
+
+  signal_win(INPUT_BOX);
+}
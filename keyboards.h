@@ -4,9 +4,12 @@ void fundamental_keymap_template(int key);
 void songlist_keymap_template(int key);
 void directory_keymap_template(int key);
 void playlist_keymap_template(int key);
+void browser_keymap_template(int key);
 void searchmode_picking_keymap(void);
 void basic_keymap(void);
 void songlist_keymap(void);
 void directory_keymap(void);
 void playlist_keymap(void);
+void browser_keymap(void);
 void searchmode_keymap(void);
+void inputbox_keymap(void);
@@ -0,0 +1,400 @@
+#include "library.h"
+#include "idle.h"
+#include "utils.h"
+
+// a snapshot being taken, on the refresh thread
+struct LibraryBuild
+{
+  struct LibraryRecord *record;
+  int count, size;
+
+  char *strings;
+  uint32_t used, capacity;
+
+  // offsets of the strings in, by their hash, 0 for an empty slot
+  uint32_t *slot;
+  int nslot, nstring;
+};
+
+static void
+intern_rehash(struct LibraryBuild *b)
+{
+  uint32_t *old = b->slot;
+  int i, n = b->nslot;
+  unsigned s;
+
+  b->nslot = n ? n * 2 : 4096;
+  b->slot = (uint32_t*) calloc(b->nslot, sizeof(uint32_t));
+
+  for(i = 0; i < n; i++)
+	if(old[i])
+	  {
+		s = hash_string(b->strings + old[i]) & (b->nslot - 1);
+		while(b->slot[s])
+		  s = (s + 1) & (b->nslot - 1);
+		b->slot[s] = old[i];
+	  }
+
+  free(old);
+}
+
+/* the offset of str in the string table, added if it's new. the
+   artists and albums come back song after song, they're kept once */
+static uint32_t
+intern(struct LibraryBuild *b, const char *str)
+{
+  uint32_t len = strlen(str) + 1;
+  unsigned s;
+
+  if(*str == '\0')
+	return 0;
+
+  if(2 * (b->nstring + 1) > b->nslot)
+	intern_rehash(b);
+
+  s = hash_string(str) & (b->nslot - 1);
+  for(; b->slot[s]; s = (s + 1) & (b->nslot - 1))
+	if(strcmp(b->strings + b->slot[s], str) == 0)
+	  return b->slot[s];
+
+  if(b->used + len > b->capacity)
+	{
+	  while(b->used + len > b->capacity)
+		b->capacity *= 2;
+	  b->strings = (char*) realloc(b->strings, b->capacity);
+	}
+
+  memcpy(b->strings + b->used, str, len);
+  b->slot[s] = b->used;
+  b->used += len;
+  b->nstring++;
+
+  return b->slot[s];
+}
+
+static const char *
+song_tag_or_empty(const struct mpd_song *song, enum mpd_tag_type type)
+{
+  const char *value = mpd_song_get_tag(song, type, 0);
+
+  return value ? value : "";
+}
+
+static void
+build_add(struct LibraryBuild *b, const struct mpd_song *song)
+{
+  const char *track = mpd_song_get_tag(song, MPD_TAG_TRACK, 0);
+  struct LibraryRecord *rec;
+
+  if(b->count == b->size)
+	{
+	  b->size = b->size ? b->size * 2 : 1024;
+	  b->record = (struct LibraryRecord*)
+		realloc(b->record, b->size * sizeof(struct LibraryRecord));
+	}
+
+  rec = b->record + b->count++;
+  rec->uri = intern(b, mpd_song_get_uri(song));
+  rec->title = intern(b, get_song_tag(song, MPD_TAG_TITLE));
+  // "" when untagged, as mpd groups them, only the title falls back
+  rec->artist = intern(b, song_tag_or_empty(song, MPD_TAG_ARTIST));
+  rec->album = intern(b, song_tag_or_empty(song, MPD_TAG_ALBUM));
+  rec->duration = mpd_song_get_duration(song);
+  rec->track = track && atoi(track) > 0 ? atoi(track) : 0;
+}
+
+static int
+write_all(int fd, const void *data, size_t len)
+{
+  const char *pt = data;
+  ssize_t n;
+
+  while(len > 0)
+	{
+	  if((n = write(fd, pt, len)) < 0)
+		return -1;
+	  pt += n;
+	  len -= n;
+	}
+
+  return 0;
+}
+
+/* write the snapshot next to the old one and swap them, so a
+   reader never maps half a file. returns 0 on success */
+static int
+build_save(struct LibraryBuild *b, const char *path, unsigned long db_update)
+{
+  struct LibraryHeader header;
+  char tmp[600];
+  int fd, err;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, LIBRARY_MAGIC, sizeof(header.magic));
+  header.db_update = db_update;
+  header.count = b->count;
+  header.strings = b->used;
+
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  if((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+	return -1;
+
+  err = write_all(fd, &header, sizeof(header))
+	|| write_all(fd, b->record, b->count * sizeof(struct LibraryRecord))
+	|| write_all(fd, b->strings, b->used);
+  err = close(fd) || err;
+
+  if(err || rename(tmp, path))
+	{
+	  unlink(tmp);
+	  return -1;
+	}
+
+  return 0;
+}
+
+static void
+build_free(struct LibraryBuild *b)
+{
+  free(b->record);
+  free(b->strings);
+  free(b->slot);
+}
+
+/* the refresh thread: ask mpd's db_update on a connection of its
+   own and take a new snapshot by listallinfo if it isn't the one
+   mapped. the main loop is told by the pipe either way */
+static void *
+library_build(void *arg)
+{
+  struct Library *lib = (struct Library*) arg;
+  unsigned long known = lib->db_update, db_update;
+  struct mpd_connection *c = mpd_connection_new(NULL, 0, 0);
+  struct LibraryBuild b;
+  struct mpd_entity *entity;
+  struct mpd_stats *stats;
+  char note = 1;
+
+  memset(&b, 0, sizeof(b));
+  b.capacity = 65536;
+  b.strings = (char*) malloc(b.capacity);
+  b.strings[b.used++] = '\0'; // offset 0
+
+  if(c == NULL || mpd_connection_get_error(c) != MPD_ERROR_SUCCESS
+	 || (stats = mpd_run_stats(c)) == NULL)
+	goto done;
+
+  db_update = mpd_stats_get_db_update_time(stats);
+  mpd_stats_free(stats);
+  lib->latest = db_update; // read on the main thread after the join
+
+  if(db_update == known && lib->map)
+	goto done;
+
+  if(!mpd_send_list_all_meta(c, ""))
+	goto done;
+
+  while(!__atomic_load_n(&lib->quit, __ATOMIC_ACQUIRE)
+		&& (entity = mpd_recv_entity(c)) != NULL)
+	{
+	  if(mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG)
+		build_add(&b, mpd_entity_get_song(entity));
+	  mpd_entity_free(entity);
+	}
+
+  // a quit leaves the response unread, the connection goes anyway
+  if(!__atomic_load_n(&lib->quit, __ATOMIC_ACQUIRE)
+	 && mpd_response_finish(c) && build_save(&b, lib->path, db_update) == 0)
+	lib->built = 1;
+
+ done:
+  if(c)
+	mpd_connection_free(c);
+  build_free(&b);
+
+  while(write(lib->notify[1], &note, 1) < 0 && errno == EINTR);
+
+  return NULL;
+}
+
+/* map the snapshot at lib->path in place of the one mapped, if
+   it's whole. returns 0 on success */
+static int
+library_map(struct Library *lib)
+{
+  const struct LibraryHeader *header;
+  const struct LibraryRecord *rec;
+  struct stat s;
+  void *map;
+  int fd, i;
+
+  if((fd = open(lib->path, O_RDONLY | O_CLOEXEC)) < 0)
+	return -1;
+
+  if(fstat(fd, &s) < 0 || (size_t)s.st_size < sizeof(struct LibraryHeader)
+	 || (map = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0))
+	 == MAP_FAILED)
+	{
+	  close(fd);
+	  return -1;
+	}
+  close(fd);
+
+  // it's read from the disk, it's checked before any offset is used
+  header = (const struct LibraryHeader*) map;
+  rec = (const struct LibraryRecord*) (header + 1);
+  if(memcmp(header->magic, LIBRARY_MAGIC, sizeof(header->magic))
+	 || header->strings == 0
+	 || (size_t)s.st_size != sizeof(struct LibraryHeader)
+	 + (size_t)header->count * sizeof(struct LibraryRecord) + header->strings
+	 || ((const char*) (rec + header->count))[header->strings - 1] != '\0')
+	{
+	  munmap(map, s.st_size);
+	  return -1;
+	}
+
+  for(i = 0; i < (int)header->count; i++)
+	if(rec[i].uri >= header->strings || rec[i].title >= header->strings
+	   || rec[i].artist >= header->strings || rec[i].album >= header->strings)
+	  {
+		munmap(map, s.st_size);
+		return -1;
+	  }
+
+  if(lib->map)
+	munmap(lib->map, lib->map_size);
+
+  lib->map = map;
+  lib->map_size = s.st_size;
+  lib->record = rec;
+  lib->strings = (const char*) (rec + header->count);
+  lib->count = header->count;
+  lib->db_update = header->db_update;
+  lib->generation++;
+
+  return 0;
+}
+
+static void
+library_start(void)
+{
+  library->built = 0;
+  library->again = 0;
+  library->latest = 0;
+  library->running =
+	pthread_create(&library->thread, NULL, library_build, library) == 0;
+}
+
+// the refresh thread is done, on the main thread
+static void
+library_on_note(void)
+{
+  char buff[16];
+
+  while(read(library->notify[0], buff, sizeof(buff)) > 0);
+
+  if(!library->running)
+	return;
+
+  pthread_join(library->thread, NULL);
+  library->running = 0;
+
+  if(library->built)
+	library_map(library);
+
+  if(library->again)
+	library_start();
+}
+
+/* have the snapshot checked against mpd's database, and taken
+   again if it's stale. a refresh running already is run once more */
+void
+library_refresh(void)
+{
+  if(library->running)
+	library->again = 1;
+  else
+	library_start();
+}
+
+/* whether the snapshot mapped is mpd's database as it is now: it
+   was checked by the latest refresh, none is running and a change
+   would be heard of */
+int
+library_current(void)
+{
+  return library->map && !library->running && idle_alive()
+	&& library->latest == library->db_update;
+}
+
+static void
+library_on_database(enum mpd_idle events)
+{
+  library_refresh();
+}
+
+// under $XDG_CACHE_HOME or ~/.cache, "" if neither is known
+static void
+library_path(char *path, int size)
+{
+  const char *cache = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+  char dir[480]; // leaves room for what goes after it
+
+  if(cache && *cache)
+	snprintf(dir, sizeof(dir), "%s", cache);
+  else if(home)
+	snprintf(dir, sizeof(dir), "%s/.cache", home);
+  else
+	{
+	  *path = '\0';
+	  return;
+	}
+
+  mkdir(dir, 0755);
+  snprintf(path, size, "%s/%s", dir, LIBRARY_DIR);
+  mkdir(path, 0755);
+  snprintf(path, size, "%s/%s/%s", dir, LIBRARY_DIR, LIBRARY_FILE);
+}
+
+struct Library *library_setup(void)
+{
+  struct Library *lib =
+	(struct Library*) calloc(1, sizeof(struct Library));
+
+  library = lib;
+  library_path(lib->path, sizeof(lib->path));
+  if(*lib->path == '\0')
+	return lib; // no snapshot, no refresh
+
+  library_map(lib); // the one of the last run, if it's there
+
+  if(pipe(lib->notify) < 0)
+	ErrorAndExit("couldn't set up the library refresh\n");
+  fcntl(lib->notify[0], F_SETFL, O_NONBLOCK);
+  watch_fd(lib->notify[0], library_on_note);
+
+  idle_listen(MPD_IDLE_DATABASE, library_on_database);
+  library_refresh(); // mpd may have updated since
+
+  return lib;
+}
+
+void library_free(struct Library *lib)
+{
+  if(lib->running)
+	{
+	  __atomic_store_n(&lib->quit, 1, __ATOMIC_RELEASE);
+	  pthread_join(lib->thread, NULL);
+	}
+
+  if(*lib->path)
+	{
+	  unwatch_fd(lib->notify[0]);
+	  close(lib->notify[0]);
+	  close(lib->notify[1]);
+	}
+
+  if(lib->map)
+	munmap(lib->map, lib->map_size);
+  free(lib);
+}
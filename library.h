@@ -0,0 +1,67 @@
+#include "global.h"
+#include <pthread.h>
+
+#ifndef EDCRFVTGBYHNUJMIKOLP
+#define EDCRFVTGBYHNUJMIKOLP
+
+#define LIBRARY_MAGIC "MPCDLIB2" // 1 had "Unknown" for untagged artists, albums
+#define LIBRARY_DIR "mpc_d" // in the cache directory
+#define LIBRARY_FILE "library"
+
+/* the snapshot on the disk is the header, count records and the
+ * string table, in that order. strings are nul terminated, each
+ * one once, offset 0 is "" */
+struct LibraryHeader
+{
+  char magic[8];
+  uint64_t db_update; // mpd's, of the database it was taken from
+  uint32_t count;
+  uint32_t strings;   // bytes of the string table
+};
+
+struct LibraryRecord
+{
+  uint32_t uri, title, artist, album; // offsets into the string table
+  uint32_t duration; // in seconds
+  uint32_t track;
+};
+
+/* all songs of mpd's database, mapped read only from the last
+ * snapshot so they're there as soon as the client starts. a thread
+ * of its own takes a new one when mpd's db_update has moved, it's
+ * mapped in its place between two frames. nothing is to hold on to
+ * a record past the frame, see generation. the library browser
+ * counts its artists and albums from it, see library_current() */
+struct Library
+{
+  void *map; // NULL while there's no snapshot
+  size_t map_size;
+  const struct LibraryRecord *record;
+  const char *strings;
+  int count;
+  unsigned long db_update;
+  int generation; // grows each time another snapshot is mapped
+
+  char path[512];
+
+  // the refresh, on its thread
+  pthread_t thread;
+  int running;
+  int again; // mpd's database changed while it ran
+  int quit;  // the client is leaving, stop at once
+  int built; // the snapshot on the disk has been replaced
+  unsigned long latest; // mpd's db_update as the refresh found it, 0 if unknown
+  int notify[2]; // pipe, thread to main loop
+};
+
+struct Library *library;
+
+#define library_string(lib, off) ((lib)->strings + (off))
+
+void library_refresh(void);
+int  library_current(void);
+
+struct Library *library_setup(void);
+void library_free(struct Library *lib);
+
+#endif
@@ -0,0 +1,642 @@
+#include "listing.h"
+#include "scanner.h"
+#include "utils.h"
+
+struct Listing *
+listing_new(const char *uri)
+{
+  struct Listing *lst =
+	(struct Listing*) calloc(1, sizeof(struct Listing));
+
+  lst->uri = strdup(uri);
+  pthread_mutex_init(&lst->lock, NULL);
+  lst->wd = -1;
+
+  return lst;
+}
+
+#define COLLATION_KEY_MAX 128 // bytes, longer names tie on the key
+
+// what an entry is compared by in qsort_r(), see compare_records()
+struct SortRecord
+{
+  unsigned long long prefix; // the first of what's compared, inline
+  int index;
+  int group; // directories first
+};
+
+static int
+push_bytes(struct Listing *lst, const char *data, int len)
+{
+  int offset = lst->used;
+
+  if(lst->used + len > lst->size)
+	{
+	  lst->size = lst->size ? lst->size * 2 : 4096;
+	  while(lst->used + len > lst->size)
+		lst->size *= 2;
+	  lst->strings = (char*) realloc(lst->strings, lst->size);
+	}
+
+  memcpy(lst->strings + offset, data, len);
+  lst->used += len;
+
+  return offset;
+}
+
+static int
+push_string(struct Listing *lst, const char *str)
+{
+  return push_bytes(lst, str, strlen(str) + 1);
+}
+
+/* a key that sorts names the way they're counted, "2" before "10":
+   a run of digits is 1, how many there are and the digits less the
+   leading zeros, the text between is 2, its strxfrm() in the
+   locale's collation and a 0. memcmp() then orders the keys as the
+   names should be, without going through the locale again */
+static int
+collation_key(char *key, const char *name)
+{
+  char run[256], full[2048];
+  const char *end;
+  size_t n;
+  int len = 0;
+
+  while(*name && len < COLLATION_KEY_MAX - 2)
+	{
+	  if(isdigit((unsigned char)*name))
+		{
+		  while(*name == '0' && isdigit((unsigned char)name[1]))
+			name++;
+		  for(end = name; isdigit((unsigned char)*end); end++);
+		  n = end - name;
+		  key[len++] = 1;
+		  key[len++] = n < 255 ? n : 255;
+		  memcpy(full, name, n);
+		}
+	  else
+		{
+		  for(end = name; *end && !isdigit((unsigned char)*end); end++);
+		  n = end - name < (int)sizeof(run) ? end - name : sizeof(run) - 1;
+		  memcpy(run, name, n);
+		  run[n] = '\0';
+		  if((n = strxfrm(full, run, sizeof(full))) >= sizeof(full))
+			n = 0;
+		  full[n++] = '\0';
+		  key[len++] = 2;
+		}
+
+	  // cut short, the rest is told by the names
+	  if(n > (size_t)(COLLATION_KEY_MAX - len))
+		n = COLLATION_KEY_MAX - len;
+	  memcpy(key + len, full, n);
+	  len += n;
+	  name = end;
+	}
+
+  return len;
+}
+
+static void
+sort_record(const struct Listing *lst, int i, struct SortRecord *rec)
+{
+  const struct SortKey *sk = &lst->sortkey[i];
+  const unsigned char *key;
+  int j;
+
+  rec->index = i;
+  rec->group = lst->kind[i] != ENTRY_DIR;
+
+  switch(lst->sort)
+	{
+	case SORT_TIME: // the unknown, -1, go last
+	  rec->prefix = (unsigned long long)LLONG_MAX - sk->mtime;
+	  break;
+	case SORT_SIZE:
+	  rec->prefix = (unsigned long long)LLONG_MAX - sk->size;
+	  break;
+	default: // big endian, so it compares as the bytes do
+	  key = (const unsigned char*) lst->strings + sk->key;
+	  for(rec->prefix = 0, j = 0; j < 8; j++)
+		rec->prefix = rec->prefix << 8 | (j < sk->keylen ? key[j] : 0);
+	}
+}
+
+/* the group and prefix settle most of them without leaving the
+   records, the whole keys are looked at for the ties */
+static int
+compare_records(const void *a, const void *b, void *arg)
+{
+  const struct SortRecord *x = a, *y = b;
+  const struct Listing *lst = arg;
+  const struct SortKey *kx, *ky;
+  int diff;
+
+  if(x->group != y->group)
+	return x->group - y->group;
+  if(x->prefix != y->prefix)
+	return x->prefix < y->prefix ? -1 : 1;
+
+  kx = &lst->sortkey[x->index];
+  ky = &lst->sortkey[y->index];
+  diff = memcmp(lst->strings + kx->key, lst->strings + ky->key,
+				kx->keylen < ky->keylen ? kx->keylen : ky->keylen);
+  if(diff == 0)
+	diff = kx->keylen - ky->keylen;
+
+  return diff ? diff : strcmp(lst->strings + lst->name[x->index],
+							  lst->strings + lst->name[y->index]);
+}
+
+/* label NULL shows the name, a directory's gets a '/'. mtime and
+   size are -1 when unknown. it may be called on the scanner's
+   thread while the main one reads lst, the entry is shown once
+   listing_publish() has put it in order */
+void
+listing_push(struct Listing *lst, int kind, const char *name,
+			 const char *label, long long mtime, long long size)
+{
+  char shown[256], key[COLLATION_KEY_MAX];
+  int i, j, keylen;
+
+  j = utf8_copy(shown, sizeof(shown) - 1, label ? label : name);
+  if(kind == ENTRY_DIR)
+	{
+	  shown[j] = '/';
+	  shown[j + 1] = '\0';
+	}
+  keylen = collation_key(key, label ? label : name);
+
+  pthread_mutex_lock(&lst->lock);
+
+  i = lst->count;
+  if(i == lst->capacity)
+	{
+	  lst->capacity = lst->capacity ? lst->capacity * 2 : 64;
+	  lst->kind = (unsigned char*) realloc(lst->kind, lst->capacity);
+	  lst->name = (int*) realloc(lst->name, lst->capacity * sizeof(int));
+	  lst->label = (int*) realloc(lst->label, lst->capacity * sizeof(int));
+	  lst->info = (struct TextInfo*)
+		realloc(lst->info, lst->capacity * sizeof(struct TextInfo));
+	  lst->sortkey = (struct SortKey*)
+		realloc(lst->sortkey, lst->capacity * sizeof(struct SortKey));
+	}
+
+  lst->kind[i] = kind;
+  lst->name[i] = push_string(lst, name);
+  lst->label[i] = strcmp(shown, name) ? push_string(lst, shown) : lst->name[i];
+  text_measure(&lst->text, &lst->info[i], shown);
+  lst->sortkey[i].key = push_bytes(lst, key, keylen);
+  lst->sortkey[i].keylen = keylen;
+  lst->sortkey[i].mtime = mtime;
+  lst->sortkey[i].size = size;
+  lst->count++;
+
+  pthread_mutex_unlock(&lst->lock);
+}
+
+/* put the entries pushed since the latest call in order. they're
+   sorted by themselves and merged in, a long scan doesn't sort all
+   it has again each time it shows more. only the thread pushing
+   to lst calls it, the main one once lst is no longer scanning */
+void
+listing_publish(struct Listing *lst)
+{
+  int from = lst->ordered, n = lst->count - from;
+  int *order, *old = lst->order, i, j, k;
+  struct SortRecord *rec, crt;
+
+  if(n <= 0)
+	return;
+
+  rec = (struct SortRecord*) malloc(n * sizeof(struct SortRecord));
+  for(j = 0; j < n; j++)
+	sort_record(lst, from + j, &rec[j]);
+  qsort_r(rec, n, sizeof(struct SortRecord), compare_records, lst);
+
+  order = (int*) malloc((lst->length + n) * sizeof(int));
+  for(i = j = k = 0; i < lst->length; i++)
+	{
+	  sort_record(lst, old[i], &crt);
+	  while(j < n && compare_records(&rec[j], &crt, lst) < 0)
+		order[k++] = rec[j++].index;
+	  order[k++] = old[i];
+	}
+  while(j < n)
+	order[k++] = rec[j++].index;
+
+  pthread_mutex_lock(&lst->lock);
+  lst->order = order;
+  lst->length = k;
+  lst->ordered = lst->count;
+  pthread_mutex_unlock(&lst->lock);
+
+  free(old);
+  free(rec);
+}
+
+/* order lst over by sort, from the keys its entries got when
+   pushed. on the main thread, once lst is no longer scanning */
+void
+listing_sort(struct Listing *lst, int sort)
+{
+  struct SortRecord *rec;
+  int i;
+
+  lst->sort = sort;
+  if(lst->length == 0)
+	return;
+
+  rec = (struct SortRecord*) malloc(lst->length * sizeof(struct SortRecord));
+  for(i = 0; i < lst->length; i++)
+	sort_record(lst, lst->order[i], &rec[i]);
+  qsort_r(rec, lst->length, sizeof(struct SortRecord), compare_records, lst);
+
+  pthread_mutex_lock(&lst->lock);
+  for(i = 0; i < lst->length; i++)
+	lst->order[i] = rec[i].index;
+  pthread_mutex_unlock(&lst->lock);
+
+  free(rec);
+}
+
+// where the entry called name is shown, -1 if it isn't
+int
+listing_find(struct Listing *lst, const char *name)
+{
+  int i, found = -1;
+
+  pthread_mutex_lock(&lst->lock);
+  for(i = 0; i < lst->length && found < 0; i++)
+	if(strcmp(listing_name(lst, i), name) == 0)
+	  found = i;
+  pthread_mutex_unlock(&lst->lock);
+
+  return found;
+}
+
+/* take the i-th entry shown out of order. the entry itself stays
+   till the listing is scanned again, it's not worth packing them
+   for a file or two */
+void
+listing_remove(struct Listing *lst, int i)
+{
+  pthread_mutex_lock(&lst->lock);
+
+  memmove(lst->order + i, lst->order + i + 1,
+		  (lst->length - i - 1) * sizeof(int));
+  lst->length--;
+
+  pthread_mutex_unlock(&lst->lock);
+}
+
+/* the listings holding each watch. a directory watched already
+   gets the same wd again, a listing let go of on the scanner's
+   thread mustn't take the watch from one listed since */
+static struct WatchRef
+{
+  int wd, refs;
+} *watch_ref;
+static int nwatch_ref, watch_ref_size;
+static pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct WatchRef *
+find_watch_ref(int wd)
+{
+  int i;
+
+  for(i = 0; i < nwatch_ref; i++)
+	if(watch_ref[i].wd == wd)
+	  return watch_ref + i;
+
+  return NULL;
+}
+
+// one holder less of wd, under watch_lock. returns the ones left
+static int
+release_watch(int wd)
+{
+  struct WatchRef *ref = find_watch_ref(wd);
+
+  if(ref == NULL)
+	return 0;
+
+  if(--ref->refs > 0)
+	return ref->refs;
+
+  *ref = watch_ref[--nwatch_ref];
+  if(nwatch_ref == 0)
+	{
+	  free(watch_ref);
+	  watch_ref = NULL;
+	  watch_ref_size = 0;
+	}
+  return 0;
+}
+
+// have the changes of a directory on the disk reported
+void
+listing_watch(struct Listing *lst)
+{
+  struct WatchRef *ref;
+
+  if(listing_notify < 0)
+	return;
+
+  pthread_mutex_lock(&watch_lock);
+
+  lst->wd = inotify_add_watch(listing_notify, lst->uri,
+							  IN_CREATE | IN_DELETE | IN_MOVED_FROM
+							  | IN_MOVED_TO | IN_DELETE_SELF
+							  | IN_MOVE_SELF | IN_ONLYDIR);
+  if(lst->wd >= 0)
+	{
+	  if((ref = find_watch_ref(lst->wd)) == NULL)
+		{
+		  if(nwatch_ref == watch_ref_size)
+			{
+			  watch_ref_size = watch_ref_size ? watch_ref_size * 2 : 16;
+			  watch_ref = (struct WatchRef*)
+				realloc(watch_ref, watch_ref_size * sizeof(struct WatchRef));
+			}
+		  ref = watch_ref + nwatch_ref++;
+		  ref->wd = lst->wd;
+		  ref->refs = 0;
+		}
+	  ref->refs++;
+	}
+
+  pthread_mutex_unlock(&watch_lock);
+}
+
+/* inotify took lst's watch away (IN_IGNORED), there's nothing to
+   remove when it's let go of */
+void
+listing_unwatch(struct Listing *lst)
+{
+  if(lst->wd < 0)
+	return;
+
+  pthread_mutex_lock(&watch_lock);
+  release_watch(lst->wd);
+  pthread_mutex_unlock(&watch_lock);
+
+  lst->wd = -1;
+}
+
+static const char *
+base_name(const char *path)
+{
+  const char *pt = strrchr(path, '/');
+
+  return pt ? pt + 1 : path;
+}
+
+/* a song is shown by its tags, which come in the same lsinfo
+   response: the track number if any, then the title (the file
+   name when untagged) */
+static void
+push_song(struct Listing *lst, const struct mpd_song *song)
+{
+  const char *uri = mpd_song_get_uri(song),
+	*track = mpd_song_get_tag(song, MPD_TAG_TRACK, 0),
+	*title = get_song_tag(song, MPD_TAG_TITLE);
+  char label[512];
+
+  if(track && atoi(track) > 0)
+	snprintf(label, sizeof(label), "%02d %s", atoi(track), title);
+  else
+	snprintf(label, sizeof(label), "%s", title);
+
+  listing_push(lst, ENTRY_SONG, base_name(uri), label,
+			   mpd_song_get_last_modified(song),
+			   mpd_song_get_duration(song));
+}
+
+/* list a directory of mpd's database, uri "" is its root. this
+   works the same whether mpd is local or on another host. it runs
+   on the scanner's thread, on a connection of its own. returns 0
+   if it got it all, else conn is broken */
+int
+listing_fetch(struct Listing *lst, struct mpd_connection *conn)
+{
+  struct mpd_entity *entity;
+  const struct mpd_directory *dir;
+
+  if(!mpd_send_list_meta(conn, lst->uri))
+	return 1;
+
+  while((entity = mpd_recv_entity(conn)) != NULL)
+	{
+	  // a cancelled response has to be read out all the same
+	  if(__atomic_load_n(&lst->cancelled, __ATOMIC_ACQUIRE))
+		{
+		  mpd_entity_free(entity);
+		  continue;
+		}
+
+	  switch(mpd_entity_get_type(entity))
+		{
+		case MPD_ENTITY_TYPE_DIRECTORY:
+		  dir = mpd_entity_get_directory(entity);
+		  listing_push(lst, ENTRY_DIR, base_name(mpd_directory_get_path(dir)),
+					   NULL, mpd_directory_get_last_modified(dir), -1);
+		  break;
+		case MPD_ENTITY_TYPE_SONG:
+		  push_song(lst, mpd_entity_get_song(entity));
+		  break;
+		default: // playlists are in their own menu
+		  break;
+		}
+
+	  mpd_entity_free(entity);
+	  scanner_progress(lst);
+	}
+
+  return !mpd_response_finish(conn);
+}
+
+void
+listing_free(struct Listing *lst)
+{
+  if(lst->wd >= 0)
+	{
+	  pthread_mutex_lock(&watch_lock);
+	  if(release_watch(lst->wd) == 0) // nobody else watches its directory
+		inotify_rm_watch(listing_notify, lst->wd);
+	  pthread_mutex_unlock(&watch_lock);
+	}
+  free(lst->uri);
+  free(lst->kind);
+  free(lst->name);
+  free(lst->label);
+  free(lst->info);
+  free(lst->sortkey);
+  free(lst->order);
+  text_pool_free(&lst->text);
+  free(lst->strings);
+  pthread_mutex_destroy(&lst->lock);
+  free(lst);
+}
+
+static unsigned
+hash_uri(const char *uri)
+{
+  return hash_string(uri) % LISTING_BUCKETS;
+}
+
+// what lst takes from the memory, near enough
+size_t
+listing_bytes(const struct Listing *lst)
+{
+  return sizeof(struct Listing) + strlen(lst->uri) + 1 + lst->size
+	+ lst->capacity * (1 + 2 * sizeof(int) + sizeof(struct TextInfo)
+					   + sizeof(struct SortKey))
+	+ lst->length * sizeof(int)
+	+ lst->text.size * sizeof(struct TextBound);
+}
+
+static void
+unlink_used(struct ListingCache *cache, struct Listing *lst)
+{
+  if(lst->newer) lst->newer->older = lst->older;
+  else cache->newest = lst->older;
+
+  if(lst->older) lst->older->newer = lst->newer;
+  else cache->oldest = lst->newer;
+}
+
+static void
+link_newest(struct ListingCache *cache, struct Listing *lst)
+{
+  lst->newer = NULL;
+  lst->older = cache->newest;
+
+  if(cache->newest) cache->newest->newer = lst;
+  else cache->oldest = lst;
+
+  cache->newest = lst;
+}
+
+// take lst out of the cache, it's the caller's again
+static void
+cache_unlink(struct ListingCache *cache, struct Listing *lst)
+{
+  struct Listing **pt = &cache->bucket[hash_uri(lst->uri)];
+
+  while(*pt != lst)
+	pt = &(*pt)->next;
+  *pt = lst->next;
+
+  unlink_used(cache, lst);
+  cache->bytes -= listing_bytes(lst);
+  cache->count--;
+  lst->cached = 0;
+}
+
+// let lst go, unless it's on the screen
+static void
+cache_remove(struct ListingCache *cache, struct Listing *lst)
+{
+  cache_unlink(cache, lst);
+
+  if(lst != cache->pinned)
+	listing_free(lst);
+}
+
+// look uri up without counting it as a use
+struct Listing *
+listing_cache_peek(struct ListingCache *cache, const char *uri)
+{
+  struct Listing *lst = cache->bucket[hash_uri(uri)];
+
+  while(lst && strcmp(lst->uri, uri))
+	lst = lst->next;
+
+  return lst;
+}
+
+struct Listing *
+listing_cache_get(struct ListingCache *cache, const char *uri)
+{
+  struct Listing *lst = listing_cache_peek(cache, uri);
+
+  if(lst && lst != cache->newest)
+	{
+	  unlink_used(cache, lst);
+	  link_newest(cache, lst);
+	}
+
+  return lst;
+}
+
+// let go of the cached lst before its time
+void
+listing_cache_drop(struct ListingCache *cache, struct Listing *lst)
+{
+  cache_remove(cache, lst);
+}
+
+static void
+cache_trim(struct ListingCache *cache, struct Listing *keep)
+{
+  struct Listing *victim, *next;
+
+  for(victim = cache->oldest; victim && cache->bytes > cache->budget;
+	  victim = next)
+	{
+	  next = victim->newer;
+	  if(victim != keep && victim != cache->pinned)
+		cache_remove(cache, victim);
+	}
+}
+
+// lst has been edited in the cache, it took before bytes
+void
+listing_cache_resized(struct ListingCache *cache, struct Listing *lst,
+					  size_t before)
+{
+  cache->bytes += listing_bytes(lst) - before;
+  cache_trim(cache, lst);
+}
+
+/* the cache owns lst from now on, an older one of its uri is let
+   go. lst itself is kept even when it alone is over budget, as is
+   the pinned one */
+void
+listing_cache_put(struct ListingCache *cache, struct Listing *lst)
+{
+  struct Listing *old = listing_cache_peek(cache, lst->uri);
+  unsigned h = hash_uri(lst->uri);
+
+  if(old)
+	{
+	  lst->cursor = old->cursor; // that's the user's, not the directory's
+	  cache_remove(cache, old);
+	}
+
+  // it's done growing, don't keep the slack against the budget
+  if(lst->used > 0 && lst->used < lst->size)
+	{
+	  lst->strings = (char*) realloc(lst->strings, lst->used);
+	  lst->size = lst->used;
+	}
+
+  lst->next = cache->bucket[h];
+  cache->bucket[h] = lst;
+  link_newest(cache, lst);
+  cache->bytes += listing_bytes(lst);
+  cache->count++;
+  lst->cached = 1;
+
+  cache_trim(cache, lst);
+}
+
+// the pinned one is only taken out, its owner frees it
+void
+listing_cache_clear(struct ListingCache *cache)
+{
+  while(cache->oldest)
+	cache_remove(cache, cache->oldest);
+}
@@ -0,0 +1,131 @@
+#include "global.h"
+#include "text.h"
+#include <pthread.h>
+
+#ifndef ZMXNCBVLAKSJDHFGQPWO
+#define ZMXNCBVLAKSJDHFGQPWO
+
+#define LISTING_BUCKETS 64
+
+// what a directory entry is listed as
+enum entry_kind
+  {
+	ENTRY_HIDDEN, // not shown: dot files, other formats, devices
+	ENTRY_DIR,
+	ENTRY_SONG
+  };
+
+// what the entries are in order of, directories always first
+enum listing_sort
+  {
+	SORT_NAME, // counting the numbers in them, "2" before "10"
+	SORT_TIME, // the latest changed first
+	SORT_SIZE, // the biggest first, the longest for mpd's songs
+	SORT_MODES
+  };
+
+// what an entry is ordered by, -1 where it's not known
+struct SortKey
+{
+  int key, keylen; // its collation key, in strings
+  long long mtime;
+  long long size;  // bytes on the disk, seconds in mpd's database
+};
+
+enum listing_state
+  {
+	LISTING_SCANNING, // the scanner thread is filling it
+	LISTING_DONE,
+	LISTING_BROKEN    // the scan failed half way, don't keep it
+  };
+
+/* the entries of one directory, from the disk or from mpd's
+ * database. each entry keeps its name (the last component of
+ * its path) and the label it is shown as, both in strings, the
+ * labels are measured for the screen as they come in. entries
+ * are only ever added, what's shown is order, the indexes of
+ * those not removed in sorted order */
+struct Listing
+{
+  char *uri; // the directory listed, "" for the root of mpd's
+  struct timespec mtime; // of a directory on the disk, to tell if it's stale
+  int cursor; // where it was when the directory was left, 0 if never
+  int cached; // it's the cache's to free
+
+  /* a directory on the disk is kept up to date through its inotify
+   * watch, -1 if it has none. changes while it's being scanned
+   * can't be told from the scan, they make it dirty */
+  int wd;
+  int dirty;
+
+  /* the scanner thread may be filling it while it's shown, what's
+   * below is under lock until state isn't LISTING_SCANNING */
+  pthread_mutex_t lock;
+  int state;     // enum listing_state
+  int cancelled; // nobody wants it anymore, the scanner frees it
+
+  int length;   // of order
+  int *order;
+  int ordered;  // the entries merged into order, see listing_publish()
+  int sort;     // enum listing_sort, of order
+
+  int count;    // entries pushed
+  int capacity;
+  unsigned char *kind;   // enum entry_kind
+  int *name, *label;     // offsets into strings
+  struct TextInfo *info; // of the labels
+  struct SortKey *sortkey;
+  struct TextPool text;
+
+  char *strings;
+  int used, size;        // bytes of strings
+
+  struct Listing *next;  // in the cache bucket
+  struct Listing *newer, *older; // in the cache's use order
+};
+
+/* listings of the directories already browsed, by their uri. the
+ * least recently used ones are let go once they take more than
+ * budget bytes */
+struct ListingCache
+{
+  struct Listing *bucket[LISTING_BUCKETS];
+  struct Listing *newest, *oldest;
+  int count;
+  size_t bytes, budget;
+
+  struct Listing *pinned; // on the screen, never freed by the cache
+};
+
+// the inotify fd the disk's listings are watched with, -1 for none
+int listing_notify;
+
+struct Listing *listing_new(const char *uri);
+void listing_push(struct Listing *lst, int kind, const char *name,
+				  const char *label, long long mtime, long long size);
+void listing_publish(struct Listing *lst);
+void listing_sort(struct Listing *lst, int sort);
+int  listing_find(struct Listing *lst, const char *name);
+void listing_remove(struct Listing *lst, int i);
+void listing_watch(struct Listing *lst);
+void listing_unwatch(struct Listing *lst);
+int  listing_fetch(struct Listing *lst, struct mpd_connection *conn);
+void listing_free(struct Listing *lst);
+
+// of the i-th entry shown
+#define listing_kind(lst, i) ((lst)->kind[(lst)->order[i]])
+#define listing_name(lst, i) ((lst)->strings + (lst)->name[(lst)->order[i]])
+#define listing_label(lst, i) ((lst)->strings + (lst)->label[(lst)->order[i]])
+#define listing_info(lst, i) (&(lst)->info[(lst)->order[i]])
+
+size_t listing_bytes(const struct Listing *lst);
+
+struct Listing *listing_cache_get(struct ListingCache *cache, const char *uri);
+struct Listing *listing_cache_peek(struct ListingCache *cache, const char *uri);
+void listing_cache_put(struct ListingCache *cache, struct Listing *lst);
+void listing_cache_drop(struct ListingCache *cache, struct Listing *lst);
+void listing_cache_resized(struct ListingCache *cache, struct Listing *lst,
+						   size_t before);
+void listing_cache_clear(struct ListingCache *cache);
+
+#endif
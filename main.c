@@ -6,12 +6,22 @@
 #include "songs.h"
 #include "directory.h"
 #include "playlists.h"
+#include "browser.h"
 #include "visualizer.h"
+#include "inputbox.h"
+#include "render.h"
+#include "commands.h"
+#include "config.h"
+#include "idle.h"
+#include "library.h"
 
 static void
 dynamic_initial(void)
 {
+  config = config_setup();
+
   conn = setup_connection();
+  idle = idle_setup();
   /* initialization require redraw too */
   interval_level = 1;
   quit_signal = 0;
@@ -39,13 +49,25 @@ dynamic_initial(void)
   directory = directory_setup();
   directory_update();
 
+  /** the library's snapshot, mapped at once, refreshed behind **/
+  library = library_setup();
+
   /** playlist arguments **/
   playlist = playlist_setup();
   playlist_update();
 
+  /** the library by its tags, asked of mpd level by level **/
+  browser = browser_setup();
+
   /** the visualizer **/
   visualizer = visualizer_setup();
   get_fifo_id();
+
+  /** keys wake the main loop up **/
+  watch_fd(STDIN_FILENO, NULL);
+
+  /** text input widget **/
+  inputbox = inputbox_setup();
   
   /** windows set initialization **/
   being_mode_update(&basic_info->wmode);
@@ -60,12 +82,30 @@ void dynamic_destroy(void)
   songlist_free(songlist);
   directory_free(directory);
   playlist_free(playlist);
+  browser_free(browser);
   visualizer_free(visualizer);
+  inputbox_free(inputbox);
+  library_free(library);
+  idle_free(idle);
+  config_free(config);
 }
 
-static void init_ncurses(void)
+static void init_ncurses(int backend)
 {
-  initscr();
+  if(backend == RENDER_HEADLESS)
+	{
+	  /* no terminal is needed, ncurses still takes the keys from
+		 stdin but what it writes goes nowhere, the screen size is
+		 taken from $LINES and $COLUMNS (24x80 if unset) */
+	  FILE *null = fopen("/dev/null", "w");
+	  if(null == NULL || newterm("xterm", null, stdin) == NULL)
+		{
+		  fprintf(stderr, "couldn't set up the headless screen\n");
+		  exit(1);
+		}
+	}
+  else
+	initscr();
 
   timeout(1); // enable the non block getch()
   curs_set(0); // cursor invisible
@@ -74,33 +114,93 @@ static void init_ncurses(void)
   color_init();
 }
 
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [-b ncurses|vt|headless] [-n frames] "
+		  "[-d dumpfile] [-m menu]\n", name);
+  exit(1);
+}
+
 int main(int argc, char **args)
 {
+  int opt, backend = RENDER_NCURSES, menu = 1, ui_due = 1;
+  long frame, max_frames = 0;
+  const char *dump_file = NULL;
+
+  while((opt = getopt(argc, args, "b:n:d:m:")) != -1)
+	{
+	  switch(opt)
+		{
+		case 'b': // rendering backend
+		  if((backend = render_backend_by_name(optarg)) < 0)
+			usage(args[0]);
+		  break;
+		case 'n': // quit after that many frames
+		  max_frames = atol(optarg);
+		  break;
+		case 'd': // dump the frames into the file
+		  dump_file = optarg;
+		  break;
+		case 'm': // the menu to start with, same as the keys
+		  menu = atoi(optarg);
+		  break;
+		default:
+		  usage(args[0]);
+		}
+	}
+
   // ncurses for unicode support
   setlocale(LC_ALL, "");
 
   // ncurses basic setting
-  init_ncurses();
+  init_ncurses(backend);
+
+  render = render_setup(backend);
+  if(dump_file && backend != RENDER_NCURSES
+	 && (render->dump = fopen(dump_file, "w")) == NULL)
+	ErrorAndExit("couldn't open the dump file");
 
   dynamic_initial();
+
+  switch(menu)
+	{
+	case 2: switch_to_songlist_menu(); break;
+	case 3: switch_to_playlist_menu(); break;
+	case 4: switch_to_directory_menu(); break;
+	case 5: switch_to_library_menu(); break;
+	default:;
+	}
   
   /** main loop for keyboard hit daemon */
-  for(;;)
+  for(frame = 0; !max_frames || frame < max_frames; frame++)
 	{
 	  being_mode->listen_keyboard();
 
 	  if(quit_signal) break;
 
-	  screen_update_checking();
-	  wchain_size_update();
+	  // a headless run is for measuring, every frame is a full redraw
+	  if(render->backend == RENDER_HEADLESS)
+		signal_all_wins();
+
+	  /* asking mpd goes by the pace of the interface, a wake for
+		 a visualizer frame only redraws */
+	  if(ui_due)
+		{
+		  screen_update_checking();
+		  wchain_size_update();
+		}
 	  screen_redraw();
 
-	  smart_sleep();
+	  if(render->backend != RENDER_HEADLESS)
+		ui_due = smart_sleep();
 	}
 
-  dynamic_destroy();
-
   endwin();
 
+  render_report(stderr);
+  render_free(render);
+
+  dynamic_destroy();
+
   return 0;
 }
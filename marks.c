@@ -0,0 +1,113 @@
+#include "marks.h"
+#include "utils.h"
+
+#define SLOT_EMPTY -1
+#define SLOT_GONE  -2 // was unmarked, the probe goes on past it
+
+/* the slot of uri, or the one it would go in if it isn't marked.
+   nslot is never filled up, the probe always ends */
+static int
+find_slot(const struct Marks *marks, const char *uri)
+{
+  unsigned mask = marks->nslot - 1, i = hash_string(uri) & mask;
+  int gone = -1, s;
+
+  while((s = marks->slot[i]) != SLOT_EMPTY)
+	{
+	  if(s == SLOT_GONE)
+		gone = gone < 0 ? (int)i : gone;
+	  else if(strcmp(marks->uri[s], uri) == 0)
+		return i;
+	  i = (i + 1) & mask;
+	}
+
+  return gone >= 0 ? gone : (int)i;
+}
+
+int
+marks_has(const struct Marks *marks, const char *uri)
+{
+  int s;
+
+  if(marks->count == 0)
+	return 0;
+
+  s = marks->slot[find_slot(marks, uri)];
+  return s >= 0;
+}
+
+/* pack out the unmarked and hash them all again, in a table big
+   enough for twice what's marked */
+static void
+rehash(struct Marks *marks)
+{
+  int i, j;
+
+  for(i = j = 0; i < marks->length; i++)
+	if(marks->uri[i])
+	  marks->uri[j++] = marks->uri[i];
+  marks->length = j;
+
+  while(marks->nslot < 4 * (marks->count + 1))
+	marks->nslot = marks->nslot ? marks->nslot * 2 : 64;
+
+  marks->slot = (int*) realloc(marks->slot, marks->nslot * sizeof(int));
+  for(i = 0; i < marks->nslot; i++)
+	marks->slot[i] = SLOT_EMPTY;
+  for(i = 0; i < marks->length; i++)
+	marks->slot[find_slot(marks, marks->uri[i])] = i;
+}
+
+void
+marks_add(struct Marks *marks, const char *uri)
+{
+  int s;
+
+  // at most half the slots in use, the unmarked included
+  if(2 * (marks->length + 1) > marks->nslot)
+	rehash(marks);
+
+  s = find_slot(marks, uri);
+  if(marks->slot[s] >= 0)
+	return;
+
+  if(marks->length == marks->size)
+	{
+	  marks->size = marks->size ? marks->size * 2 : 64;
+	  marks->uri = (char**) realloc(marks->uri, marks->size * sizeof(char*));
+	}
+
+  marks->uri[marks->length] = strdup(uri);
+  marks->slot[s] = marks->length++;
+  marks->count++;
+}
+
+void
+marks_remove(struct Marks *marks, const char *uri)
+{
+  int s, i;
+
+  if(marks->count == 0)
+	return;
+
+  s = find_slot(marks, uri);
+  if((i = marks->slot[s]) < 0)
+	return;
+
+  free(marks->uri[i]);
+  marks->uri[i] = NULL;
+  marks->slot[s] = SLOT_GONE;
+  marks->count--;
+}
+
+void
+marks_clear(struct Marks *marks)
+{
+  int i;
+
+  for(i = 0; i < marks->length; i++)
+	free(marks->uri[i]);
+  free(marks->uri);
+  free(marks->slot);
+  memset(marks, 0, sizeof(struct Marks));
+}
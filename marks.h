@@ -0,0 +1,25 @@
+#include "global.h"
+
+#ifndef QAZWSXEDCRFVTGBYHNUJ
+#define QAZWSXEDCRFVTGBYHNUJ
+
+/* the uris picked in the directory browser, across directories.
+ * they're kept in the order they were marked, which is the order
+ * they're added in, and found by a hash of them for the redraw */
+struct Marks
+{
+  char **uri;  // NULL where one has been unmarked
+  int length;  // of uri, the unmarked too
+  int size;
+  int count;   // still marked
+
+  int *slot;   // indexes into uri, open addressing, see find_slot()
+  int nslot;   // a power of 2, 0 before the first mark
+};
+
+int  marks_has(const struct Marks *marks, const char *uri);
+void marks_add(struct Marks *marks, const char *uri);
+void marks_remove(struct Marks *marks, const char *uri);
+void marks_clear(struct Marks *marks);
+
+#endif
@@ -1,6 +1,9 @@
 #include "playlists.h"
 #include "utils.h"
 #include "keyboards.h"
+#include "inputbox.h"
+#include "idle.h"
+#include "text.h"
 
 void
 playlist_redraw_screen(void)
@@ -9,17 +12,29 @@ playlist_redraw_screen(void)
   
   WINDOW *win = specific_win(PLAYLIST);  
 
-  char *filename;
-  int line = 0;
+  // the name, then the day it was last saved at the right edge
+  const int cols = wchain[PLAYLIST].win->_maxx - 6;
+  char name[512], date[16], buff[1024];
+  struct tm tm;
+  int w, line = 0;
+
+  if(cols <= 10)
+	return;
+
   for(i = playlist->begin - 1; i < playlist->begin
 		+ height - 1 && i < playlist->length; i++)
 	{
-	  filename = playlist->tapename[i];
+	  localtime_r(&playlist->stored[i].mtime, &tm);
+	  strftime(date, sizeof(date), "%y-%m-%d", &tm);
+	  w = utf8_fit(name, sizeof(name), playlist->stored[i].name,
+				   cols - strlen(date) - 1);
+	  snprintf(buff, sizeof(buff), "%s%*s%s", name,
+			   (int)(cols - strlen(date) - w), "", date);
 
 	  if(i + 1 == playlist->cursor)
-		print_list_item(win, line++, 2, i + 1, filename, NULL);
+		print_list_item(win, line++, 2, i + 1, buff, NULL);
 	  else
-		print_list_item(win, line++, 0, i + 1, filename, NULL);
+		print_list_item(win, line++, 0, i + 1, buff, NULL);
 	}
 }
 
@@ -66,48 +81,79 @@ playlist_helper(void)
   color_print(win, 3, " Instruction: ");
 }
 
-void playlist_update_checking(void)
+static int
+by_name(const void *a, const void *b)
 {
-  if(playlist->update_signal)
-	{
-	  playlist_update();
-	  playlist->update_signal = 0;
-	  signal_all_wins();
-	}
+  return strcmp(((const struct StoredPlaylist*) a)->name,
+				((const struct StoredPlaylist*) b)->name);
 }
 
+/* "listplaylists" has the stored playlists alone with their
+   times, the root's lsinfo would bring all of the root with them */
 void
 playlist_update(void)
 {
-	struct mpd_entity *entity;
-	const struct mpd_playlist *plist;
+  struct StoredPlaylist *stored;
+  struct mpd_playlist *plist;
+  int i;
 
-	int i = 0;
+  for(i = 0; i < playlist->length; i++)
+	free(playlist->stored[i].name);
+  playlist->length = 0;
 
-	if (!mpd_send_list_meta(conn, ""))
-	  return printErrorAndExit(conn);
-	
-	while((entity = mpd_recv_entity(conn)) != NULL)
-	  {
-		if(i >= 128) break;
-
-		enum mpd_entity_type type = mpd_entity_get_type(entity);
-		if(type != MPD_ENTITY_TYPE_PLAYLIST)
-		  {
-			mpd_entity_free(entity);
-			continue;
-		  }
-		
-		plist = mpd_entity_get_playlist(entity);
-		strncpy(playlist->tapename[i],
-				mpd_playlist_get_path(plist), 512);
-
-		mpd_entity_free(entity);
-
-		i++;
-	  }
-
-	playlist->length = i;
+  if(!mpd_send_list_playlists(conn))
+	return printErrorAndExit(conn);
+
+  while((plist = mpd_recv_playlist(conn)) != NULL)
+	{
+	  if(playlist->length == playlist->size)
+		{
+		  playlist->size = playlist->size ? playlist->size * 2 : 32;
+		  playlist->stored = (struct StoredPlaylist*) realloc
+			(playlist->stored, playlist->size * sizeof(struct StoredPlaylist));
+		}
+
+	  stored = playlist->stored + playlist->length++;
+	  stored->name = strdup(mpd_playlist_get_path(plist));
+	  stored->mtime = mpd_playlist_get_last_modified(plist);
+
+	  mpd_playlist_free(plist);
+	}
+
+  my_finishCommand(conn);
+
+  qsort(playlist->stored, playlist->length,
+		sizeof(struct StoredPlaylist), by_name);
+
+  if(playlist->length > 0 && playlist->cursor > playlist->length)
+	playlist_scroll_to(playlist->length); // it has shrunk
+}
+
+// mpd's stored playlists changed, by us or by anyone else
+static void
+playlist_on_change(enum mpd_idle events)
+{
+  playlist_update();
+  signal_win(PLAYLIST);
+}
+
+/* a change made here is heard of by the idle connection like any
+   other, without it the list is taken again right away */
+static void
+playlist_changed(void)
+{
+  if(!idle_alive())
+	playlist_update();
+}
+
+// the playlist under the cursor, NULL if there's none
+static const char *
+crt_playlist_name(void)
+{
+  if(playlist->cursor < 1 || playlist->cursor > playlist->length)
+	return NULL;
+
+  return playlist->stored[playlist->cursor - 1].name;
 }
 
 static int
@@ -117,18 +163,20 @@ is_playlist_name_conflict(const char* name)
   
   for(i = 0; i < playlist->length; i++)
 	{
-	  if(strcmp(playlist->tapename[i], name) == 0)
+	  if(strcmp(playlist->stored[i].name, name) == 0)
 		return 1;
 	}
 
   return 0;
 }
 
-void playlist_rename(void)
-{
-  char *to =
-	popup_input_dialog("New Name Here:");
+/* the name being renamed is kept aside when the input box
+   opens, the list may be refreshed while the user is typing */
+static char rename_from[512];
 
+static void
+playlist_rename_finish(const char *to)
+{
   if(is_playlist_name_conflict(to))
 	{
 	  char message[512];
@@ -148,16 +196,29 @@ void playlist_rename(void)
   if(!choice) // action canceled
 	return;
 
-  const char *from = playlist->tapename[playlist->cursor - 1];
+  mpd_run_rename(conn, rename_from, to);
 
-  mpd_run_rename(conn, from, to);
+  playlist_changed();
+}
+
+void playlist_rename(void)
+{
+  const char *name = crt_playlist_name();
+
+  if(name == NULL)
+	return;
+
+  strncpy(rename_from, name, sizeof(rename_from) - 1);
 
-  playlist->update_signal = 1;
+  inputbox_open("New Name Here:", &playlist_rename_finish);
 }
 
 void playlist_load(void)
 {
-  const char *name = playlist->tapename[playlist->cursor - 1];
+  const char *name = crt_playlist_name();
+
+  if(name == NULL)
+	return;
 
   mpd_run_load(conn, name);
 
@@ -166,11 +227,9 @@ void playlist_load(void)
   popup_simple_dialog(message);
 }
 
-void playlist_save(void)
+static void
+playlist_save_finish(const char *name)
 {
-  char *name =
-	popup_input_dialog("New Name Here:");
-
   if(is_playlist_name_conflict(name))
 	{
 	  char message[512];
@@ -180,6 +239,9 @@ void playlist_save(void)
 	  
 	  return;
 	}
+
+  if(!*name) // empty string
+	return;
 	
   int choice =
 	popup_confirm_dialog("Saving Confirm:", 1);
@@ -189,12 +251,20 @@ void playlist_save(void)
 
   mpd_run_save(conn, name);
 
-  playlist->update_signal = 1;  
+  playlist_changed();
+}
+
+void playlist_save(void)
+{
+  inputbox_open("New Name Here:", &playlist_save_finish);
 }
 
 void playlist_cover(void)
 {
-  const char *name = playlist->tapename[playlist->cursor - 1];
+  const char *name = crt_playlist_name();
+
+  if(name == NULL)
+	return;
 
   char message[512];
 
@@ -208,11 +278,16 @@ void playlist_cover(void)
 
   snprintf(message, sizeof(message), "\"%s\" Has Been Covered.", name);
   popup_simple_dialog(message);
+
+  playlist_changed(); // name goes with the old list
 }
 
 void playlist_delete(void)
 {
-  const char *name = playlist->tapename[playlist->cursor - 1];
+  const char *name = crt_playlist_name();
+
+  if(name == NULL)
+	return;
 
   char message[512];
 
@@ -226,7 +301,7 @@ void playlist_delete(void)
   snprintf(message, sizeof(message), "\"%s\" Has Been Deleted.", name);
   popup_simple_dialog(message);
 
-  playlist->update_signal = 1;  
+  playlist_changed();
 }
 
 void playlist_replace(void)
@@ -237,7 +312,10 @@ void playlist_replace(void)
   if(!choice) // action canceled
 	return;
 
-  const char *name = playlist->tapename[playlist->cursor - 1];
+  const char *name = crt_playlist_name();
+
+  if(name == NULL)
+	return;
 
   mpd_run_clear(conn);
   mpd_run_load(conn, name);
@@ -252,7 +330,8 @@ struct Playlist *playlist_setup(void)
   struct Playlist *plist =
 	(struct Playlist*) malloc(sizeof(struct Playlist));
 
-  plist->update_signal = 0;
+  plist->stored = NULL;
+  plist->size = 0;
   plist->begin = 1;
   plist->length = 0;
   plist->cursor = 1;
@@ -269,11 +348,18 @@ struct Playlist *playlist_setup(void)
   plist->wmode.wins[5] = &wchain[PLAYICON];
   plist->wmode.listen_keyboard = &playlist_keymap;
 
+  idle_listen(MPD_IDLE_STORED_PLAYLIST, playlist_on_change);
+
   return plist;
 }
 
 void playlist_free(struct Playlist *plist)
 {
+  int i;
+
+  for(i = 0; i < plist->length; i++)
+	free(plist->stored[i].name);
+  free(plist->stored);
   free(plist->wmode.wins);
   free(plist);
 }
@@ -4,14 +4,22 @@
 #ifndef LFKJNCAEFLJPOUzlSKJF
 #define LFKJNCAEFLJPOUzlSKJF
 
+// a playlist stored on mpd's side
+struct StoredPlaylist
+{
+  char *name;
+  time_t mtime; // last modified
+};
+
 struct Playlist
 {
-  char tapename[128][512];
+  /* all stored playlists by name, listed again only when mpd
+   * reports a change to them, see playlist_on_change() */
+  struct StoredPlaylist *stored;
+  int size; // allocated
 
   struct WinMode wmode;
 
-  int update_signal;
-  
   int length;
   int begin;
   int cursor;
@@ -20,7 +28,6 @@ struct Playlist
 struct Playlist *playlist;  
 
 void playlist_redraw_screen(void);
-void playlist_update_checking(void);
 void playlist_update(void);
 void playlist_display_icon(void);
 void playlist_helper(void);
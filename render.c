@@ -0,0 +1,570 @@
+#include "render.h"
+#include "utils.h"
+
+static const char *backend_names[] = {"ncurses", "vt", "headless"};
+
+int
+render_backend_by_name(const char *name)
+{
+  int i;
+
+  for(i = 0; i < (int)(sizeof(backend_names) / sizeof(*backend_names)); i++)
+	if(strcmp(backend_names[i], name) == 0)
+	  return i;
+
+  return -1;
+}
+
+/* stage the window for the coming frame, nothing reaches the
+   terminal until window_commit(), so a whole redraw pass is
+   written out in one go. returns the number of cells changed,
+   which ncurses keeps to itself */
+int
+window_stage(WINDOW *win)
+{
+  if(render->backend == RENDER_NCURSES)
+	{
+	  wnoutrefresh(win);
+	  return 0;
+	}
+  else
+	return render_blit(win);
+}
+
+void
+window_commit(void)
+{
+  if(render->backend == RENDER_NCURSES)
+	doupdate();
+  else
+	render_flush();
+}
+
+void
+window_refresh(WINDOW *win)
+{
+  window_stage(win);
+  window_commit();
+}
+
+static int
+is_cell_equal(const struct Cell *a, const struct Cell *b)
+{
+  return a->ch == b->ch && a->attr == b->attr && a->pair == b->pair;
+}
+
+static void
+set_blank(struct Cell *cell, int pair)
+{
+  cell->ch = L' ';
+  cell->attr = 0;
+  cell->pair = pair;
+}
+
+/* ncurses draws the lines and borders with the VT100 alternate
+   character set, here they are turned into the unicode ones */
+static wchar_t
+acs_to_unicode(wchar_t ch)
+{
+  static const char acs[] = "jklmnqtuvwxa`f~,+.-0hgyz{|}os";
+  static const wchar_t uni[] =
+	L"┘┐┌└┼─├┤┴┬│▒◆°·←→↓↑█░±≤≥π≠£⎺⎽";
+  const char *pt;
+
+  if(ch > 0 && ch < 128 && (pt = strchr(acs, (int)ch)))
+	return uni[pt - acs];
+
+  return ch;
+}
+
+/* copy the cells of a curses window into the back grid,
+   returns the number of cells changed */
+int
+render_blit(WINDOW *win)
+{
+  int y, x, top, left, rows, cols, cy, cx, changed = 0;
+  struct Cell *row, *cell, old;
+  wchar_t wch[CCHARW_MAX + 1];
+  attr_t attr;
+  short pair;
+  cchar_t cc;
+
+  getbegyx(win, top, left);
+  getmaxyx(win, rows, cols);
+  getyx(win, cy, cx);
+
+  for(y = 0; y < rows && top + y < render->height; y++)
+	{
+	  row = render->back + (top + y) * render->width;
+
+	  for(x = 0; x < cols && left + x < render->width; x++)
+		{
+		  cell = row + left + x;
+		  old = *cell;
+
+		  if(mvwin_wch(win, y, x, &cc) == ERR
+			 || getcchar(&cc, wch, &attr, &pair, NULL) == ERR)
+			{
+			  set_blank(cell, 0);
+			  changed += !is_cell_equal(cell, &old);
+			  continue;
+			}
+
+		  cell->ch = *wch ? *wch : L' ';
+		  if(attr & A_ALTCHARSET)
+			{
+			  cell->ch = acs_to_unicode(cell->ch);
+			  attr &= ~A_ALTCHARSET;
+			}
+		  cell->attr = attr & ~A_COLOR;
+		  cell->pair = pair;
+		  changed += !is_cell_equal(cell, &old);
+
+		  // the next column is taken by the right half
+		  if(wcwidth(cell->ch) == 2 && x + 1 < cols
+			 && left + x + 1 < render->width)
+			{
+			  x++, cell++;
+			  cell->ch = 0;
+			  cell->attr = attr & ~A_COLOR;
+			  cell->pair = pair;
+			}
+		}
+	}
+
+  /* put the cursor back and mark the window as refreshed,
+	 otherwise a wgetch() on it would let ncurses write the
+	 window out by itself */
+  wmove(win, cy, cx);
+  untouchwin(win);
+  win->_flags &= ~_HASMOVED;
+
+  render->dirty = 1;
+
+  return changed;
+}
+
+static void
+out_append(const char *str, int len)
+{
+  if(render->out_len + len > render->out_size)
+	{
+	  render->out_size = 2 * (render->out_len + len);
+	  render->out = (char*) realloc(render->out, render->out_size);
+	}
+
+  memcpy(render->out + render->out_len, str, len);
+  render->out_len += len;
+}
+
+static void
+out_str(const char *str)
+{
+  out_append(str, strlen(str));
+}
+
+static void
+out_int(const char *prefix, int num, const char *suffix)
+{
+  char seq[32];
+  int n = snprintf(seq, sizeof(seq), "%s%d%s", prefix, num, suffix);
+  out_append(seq, n);
+}
+
+// ;30 to ;37, ;90 to ;97, or ;38;5;n for the 256 colors
+static void
+out_color(int base, int color)
+{
+  if(color < 8)
+	out_int(";", base + color, "");
+  else if(color < 16)
+	out_int(";", base + 60 + color - 8, "");
+  else
+	{
+	  out_int(";", base + 8, "");
+	  out_int(";5;", color, "");
+	}
+}
+
+static void
+out_sgr(attr_t attr, short pair)
+{
+  short fg = -1, bg = -1;
+
+  if(pair > 0)
+	pair_content(pair, &fg, &bg);
+
+  out_str("\033[0");
+  if(attr & A_BOLD)      out_str(";1");
+  if(attr & A_DIM)       out_str(";2");
+  if(attr & A_UNDERLINE) out_str(";4");
+  if(attr & A_BLINK)     out_str(";5");
+  if(attr & A_REVERSE)   out_str(";7");
+  if(fg >= 0)
+	out_color(30, fg);
+  if(bg >= 0)
+	out_color(40, bg);
+  out_str("m");
+}
+
+static void
+out_char(wchar_t ch)
+{
+  char mb[MB_LEN_MAX];
+  mbstate_t state;
+  size_t n;
+
+  memset(&state, 0, sizeof(state));
+  n = wcrtomb(mb, ch, &state);
+
+  if(n == (size_t)-1)
+	out_str("?");
+  else
+	out_append(mb, n);
+}
+
+/* move from (cy, cx) to (y, x) with the cheapest sequence at
+   hand, skipping a short run of untouched cells by printing
+   them again is cheaper than any escape. cy is -1 while where
+   the cursor is isn't known, only an absolute move will do */
+static void
+out_move(int y, int x, int cy, int cx, attr_t attr, short pair)
+{
+  int i, gap = x - cx;
+  struct Cell *cell = render->front + y * render->width + cx;
+
+  if(cy >= 0 && y == cy && gap > 0)
+	{
+	  for(i = 0; i < gap && gap <= 3; i++)
+		if(cell[i].ch > 127 || cell[i].ch < 32 || cell[i].pair != pair
+		   || cell[i].attr != attr)
+		  break;
+
+	  if(i == gap)
+		for(i = 0; i < gap; i++)
+		  out_char(cell[i].ch);
+	  else if(gap == 1)
+		out_str("\033[C");
+	  else
+		out_int("\033[", gap, "C");
+	}
+  else if(cy >= 0 && y == cy + 1 && x == 0)
+	out_str("\r\n");
+  else if(x == 0)
+	out_int("\033[", y + 1, "H");
+  else
+	{
+	  out_int("\033[", y + 1, ";");
+	  out_int("", x + 1, "H");
+	}
+}
+
+static int
+is_cell_blank(const struct Cell *cell)
+{
+  return cell->ch == L' ' && cell->attr == 0 && cell->pair == 0;
+}
+
+/* nothing to write to, the frame is only taken into account */
+static void
+headless_flush(void)
+{
+  int i, changed = 0;
+
+  for(i = 0; i < render->height * render->width; i++)
+	if(!is_cell_equal(render->back + i, render->front + i))
+	  {
+		render->front[i] = render->back[i];
+		changed++;
+	  }
+
+  render->frames++;
+  render->frame_cells = changed;
+  render->total_cells += changed;
+
+  if(changed && render->dump)
+	render_dump_frame();
+}
+
+/* write out the difference between the back and the front
+   grid, wrapped in a synchronized update (DEC mode 2026) so
+   the terminal paints the frame at once */
+void
+render_flush(void)
+{
+  int y, x, w, blank_from, cy = -1, cx = -1, changed = 0;
+  struct Cell *back, *front;
+  ssize_t n;
+  int written;
+
+  if(!render->dirty)
+	return;
+
+  if(render->backend == RENDER_HEADLESS)
+	{
+	  headless_flush();
+	  render->dirty = 0;
+	  return;
+	}
+
+  render->out_len = 0;
+  out_str("\033[?2026h");
+
+  for(y = 0; y < render->height; y++)
+	{
+	  back = render->back + y * render->width;
+	  front = render->front + y * render->width;
+
+	  // the rest of the row from here on is blank
+	  for(blank_from = render->width; blank_from > 0
+			&& is_cell_blank(back + blank_from - 1); blank_from--);
+
+	  for(x = 0; x < render->width; x++)
+		{
+		  if(is_cell_equal(back + x, front + x))
+			continue;
+
+		  // right half, it was printed along with the left half
+		  if(back[x].ch == 0)
+			{
+			  front[x] = back[x];
+			  continue;
+			}
+
+		  if(y != cy || x != cx)
+			out_move(y, x, cy, cx, render->attr, render->pair);
+
+		  if(back[x].attr != render->attr || back[x].pair != render->pair)
+			{
+			  render->attr = back[x].attr;
+			  render->pair = back[x].pair;
+			  out_sgr(render->attr, render->pair);
+			}
+
+		  changed++;
+
+		  // wipe out the tail of the row with one erase in line
+		  if(x >= blank_from && render->attr == 0 && render->pair == 0)
+			{
+			  out_str("\033[K");
+			  for(; x < render->width; x++)
+				front[x] = back[x];
+			  cy = y, cx = x;
+			  continue;
+			}
+
+		  w = wcwidth(back[x].ch);
+		  out_char(w > 0 ? back[x].ch : L'?');
+
+		  front[x] = back[x];
+		  if(w == 2 && x + 1 < render->width)
+			{
+			  x++;
+			  front[x] = back[x];
+			}
+
+		  cy = y, cx = x + 1;
+		}
+	}
+
+  out_str("\033[?2026l");
+
+  // the windows were redrawn with the same content
+  if(!changed)
+	render->out_len = 0;
+
+  for(written = 0; written < render->out_len; written += n)
+	{
+	  n = write(STDOUT_FILENO, render->out + written,
+				render->out_len - written);
+	  if(n < 0)
+		break;
+	}
+
+  if(changed) // a frame that wrote nothing isn't one on the terminal
+	render->frames++;
+  render->frame_bytes = render->out_len;
+  render->total_bytes += render->out_len;
+  render->frame_cells = changed;
+  render->total_cells += changed;
+  render->dirty = 0;
+
+  if(changed && render->dump)
+	render_dump_frame();
+}
+
+/* time is taken by the caller before the routine runs */
+void
+render_account(int id, long long start, int cells)
+{
+  struct RoutineStat *stat = render->routine + id;
+
+  stat->calls++;
+  stat->cells += cells;
+  stat->us += get_monotonic_us() - start;
+}
+
+/* the front grid as plain text, one line per row */
+void
+render_dump_frame(void)
+{
+  int y, x, end;
+  struct Cell *row;
+  char mb[MB_LEN_MAX];
+  mbstate_t state;
+  size_t n;
+
+  fprintf(render->dump, "--- frame %ld, %ld cells changed\n",
+		  render->frames, render->frame_cells);
+
+  memset(&state, 0, sizeof(state));
+  for(y = 0; y < render->height; y++)
+	{
+	  row = render->front + y * render->width;
+
+	  // trailing blanks are left out
+	  for(end = render->width; end > 0 && row[end - 1].ch == L' '; end--);
+
+	  for(x = 0; x < end; x++)
+		{
+		  if(row[x].ch == 0)
+			continue;
+		  n = wcrtomb(mb, row[x].ch, &state);
+		  if(n == (size_t)-1)
+			fputc('?', render->dump);
+		  else
+			fwrite(mb, 1, n, render->dump);
+		}
+
+	  fputc('\n', render->dump);
+	}
+}
+
+/* forget what the terminal shows, the next frame clears the
+   screen and paints everything again */
+void
+render_invalidate(void)
+{
+  int i;
+
+  if(render->backend == RENDER_NCURSES)
+	{
+	  clearok(curscr, TRUE);
+	  return;
+	}
+
+  if(render->backend == RENDER_HEADLESS)
+	{
+	  for(i = 0; i < render->height * render->width; i++)
+		render->front[i].pair = -1;
+	  render->dirty = 1;
+	  return;
+	}
+
+  const char *clear = "\033[0m\033[2J";
+  if(write(STDOUT_FILENO, clear, strlen(clear)) < 0)
+	return;
+
+  render->attr = 0;
+  render->pair = 0;
+
+  // a cleared screen is all blanks
+  for(i = 0; i < render->height * render->width; i++)
+	set_blank(render->front + i, 0);
+
+  render->dirty = 1;
+}
+
+void
+render_resize(int height, int width)
+{
+  int i, size = height * width;
+
+  if(render->backend == RENDER_NCURSES)
+	return;
+
+  render->height = height;
+  render->width = width;
+
+  render->front = (struct Cell*)
+	realloc(render->front, size * sizeof(struct Cell));
+  render->back = (struct Cell*)
+	realloc(render->back, size * sizeof(struct Cell));
+
+  for(i = 0; i < size; i++)
+	set_blank(render->back + i, 0);
+
+  render_invalidate();
+}
+
+void
+render_report(FILE *fp)
+{
+  int i;
+  struct RoutineStat *stat;
+
+  // ncurses doesn't tell how much it has written
+  if(render->backend == RENDER_NCURSES)
+	return;
+
+  fprintf(fp, "%s backend: %ld frames, %ld cells changed",
+		  backend_names[render->backend], render->frames,
+		  render->total_cells);
+  if(render->backend == RENDER_VT)
+	fprintf(fp, ", %ld bytes, %.1f bytes/frame", render->total_bytes,
+			render->frames ? (double)render->total_bytes / render->frames : 0.);
+  fputc('\n', fp);
+
+  fprintf(fp, "%-22s %8s %12s %10s %12s\n",
+		  "window", "calls", "total(us)", "us/call", "cells");
+  for(i = 0; i < WIN_NUM; i++)
+	{
+	  stat = render->routine + i;
+	  if(stat->calls == 0)
+		continue;
+
+	  fprintf(fp, "%-22s %8ld %12lld %10.1f %12ld\n",
+			  wchain[i].name, stat->calls, stat->us,
+			  (double)stat->us / stat->calls, stat->cells);
+	}
+}
+
+struct Render *render_setup(int backend)
+{
+  struct Render *r =
+	(struct Render*) malloc(sizeof(struct Render));
+
+  r->backend = backend;
+  r->height = r->width = 0;
+  r->front = r->back = NULL;
+  r->dirty = 0;
+
+  r->out = NULL;
+  r->out_len = r->out_size = 0;
+
+  r->attr = 0;
+  r->pair = -1;
+
+  r->frames = r->frame_bytes = r->total_bytes = 0;
+  r->frame_cells = r->total_cells = 0;
+  memset(r->routine, 0, sizeof(r->routine));
+  r->dump = NULL;
+
+  /* stdscr is never drawn on, refresh it for once so the
+	 getch() will never have anything to write out later,
+	 since then ncurses is used for the input only */
+  if(backend != RENDER_NCURSES)
+	refresh();
+
+  return r;
+}
+
+void render_free(struct Render *r)
+{
+  if(r->dump)
+	fclose(r->dump);
+  free(r->front);
+  free(r->back);
+  free(r->out);
+  free(r);
+}
@@ -0,0 +1,77 @@
+#include "global.h"
+#include "windows.h"
+
+#ifndef POQWIEJFLKSADJFQWEO
+#define POQWIEJFLKSADJFQWEO
+
+/* where the windows end up, ncurses does its own screen
+ * optimization, the others keep a cell grid by themselves */
+enum render_backend
+  {
+	RENDER_NCURSES,          // wrefresh() as usual
+	RENDER_VT,               // cell-grid diff written as raw escapes
+	RENDER_HEADLESS          // cell grid in memory, no terminal at all
+  };
+
+// cost of the redraw routine of one window
+struct RoutineStat
+{
+  long calls;
+  long cells;     // cells changed by the routine
+  long long us;   // time spent in the routine
+};
+
+struct Cell
+{
+  wchar_t ch;  // 0 stands for the right half of a wide character
+  attr_t attr; // attributes without the color
+  short pair;  // -1 marks a cell whose content is unknown
+};
+
+struct Render
+{
+  int backend;
+  int height, width;
+
+  struct Cell *front; // what the terminal is showing now
+  struct Cell *back;  // what the next frame is going to show
+  int dirty;          // back differs from front somewhere
+
+  char *out;          // escape sequences of the frame being built
+  int out_len;
+  int out_size;
+
+  // graphic rendition the terminal is using, pair -1 if unknown
+  attr_t attr;
+  short pair;
+
+  // statistics for comparing the backends
+  long frames;
+  long frame_bytes;   // bytes written by the last frame
+  long total_bytes;
+  long frame_cells;   // cells changed by the last frame
+  long total_cells;
+
+  struct RoutineStat routine[WIN_NUM];
+
+  FILE *dump;         // frames are dumped here if not NULL
+};
+
+struct Render *render;
+
+int  render_backend_by_name(const char *name);
+int  window_stage(WINDOW *win);
+void window_commit(void);
+void window_refresh(WINDOW *win);
+int  render_blit(WINDOW *win);
+void render_flush(void);
+void render_account(int id, long long start, int cells);
+void render_dump_frame(void);
+void render_invalidate(void);
+void render_resize(int height, int width);
+void render_report(FILE *fp);
+
+struct Render *render_setup(int backend);
+void render_free(struct Render *r);
+
+#endif
@@ -0,0 +1,194 @@
+#include "scanner.h"
+#include "utils.h"
+
+// write a note unless one is waiting to be read already
+static void
+scanner_note(void)
+{
+  char c = 1;
+
+  if(!__atomic_exchange_n(&scanner->noted, 1, __ATOMIC_ACQ_REL))
+	if(write(scanner->notify[1], &c, 1) < 0)
+	  __atomic_store_n(&scanner->noted, 0, __ATOMIC_RELEASE);
+}
+
+/* called by fill() as it goes, the main loop is told at most every
+   SCAN_NOTE_US so that a huge directory costs a few redraws and a
+   few merges into its order */
+void
+scanner_progress(struct Listing *lst)
+{
+  long long now = get_monotonic_us();
+
+  if(now - scanner->last_note >= SCAN_NOTE_US)
+	{
+	  scanner->last_note = now;
+	  listing_publish(lst);
+	  scanner_note();
+	}
+}
+
+static void *
+scanner_loop(void *arg)
+{
+  struct Scanner *scn = (struct Scanner*) arg;
+  struct Listing *lst;
+  int incomplete;
+
+  pthread_mutex_lock(&scn->lock);
+  while(!scn->quit)
+	{
+	  if((lst = scn->job) != NULL)
+		scn->job = NULL;
+	  else if((lst = scn->spare) != NULL)
+		scn->spare = NULL;
+	  else
+		{
+		  pthread_cond_wait(&scn->wake, &scn->lock);
+		  continue;
+		}
+
+	  scn->current = lst;
+	  pthread_mutex_unlock(&scn->lock);
+
+	  scn->last_note = 0; // the first entries are shown at once
+	  incomplete = scn->fill(lst);
+	  if(!__atomic_load_n(&lst->cancelled, __ATOMIC_ACQUIRE))
+		listing_publish(lst); // what's left since the latest note
+
+	  pthread_mutex_lock(&scn->lock);
+	  scn->current = NULL;
+
+	  if(__atomic_load_n(&lst->cancelled, __ATOMIC_ACQUIRE))
+		listing_free(lst); // nobody else holds it anymore
+	  else
+		{
+		  pthread_mutex_lock(&lst->lock);
+		  lst->state = incomplete ? LISTING_BROKEN : LISTING_DONE;
+		  pthread_mutex_unlock(&lst->lock);
+		  scanner_note();
+		}
+	}
+  pthread_mutex_unlock(&scn->lock);
+
+  return NULL;
+}
+
+// have lst filled, it's shown while it's filling
+void
+scanner_start(struct Listing *lst)
+{
+  pthread_mutex_lock(&scanner->lock);
+
+  if(scanner->job) // never started, nobody wants it
+	listing_free(scanner->job);
+
+  scanner->job = lst;
+  pthread_cond_signal(&scanner->wake);
+
+  pthread_mutex_unlock(&scanner->lock);
+}
+
+/* have lst filled when the thread has nothing else to do, it's
+   for the cache. a new job doesn't wait for one being filled, the
+   caller cancels it if it's in the way */
+void
+scanner_prefetch(struct Listing *lst)
+{
+  pthread_mutex_lock(&scanner->lock);
+
+  if(scanner->spare)
+	listing_free(scanner->spare);
+
+  scanner->spare = lst;
+  pthread_cond_signal(&scanner->wake);
+
+  pthread_mutex_unlock(&scanner->lock);
+}
+
+/* the main loop no longer wants lst. returns 1 if the scanner took
+   it over to let it go, 0 if it's finished and still the caller's */
+int
+scanner_cancel(struct Listing *lst)
+{
+  int taken = 1;
+
+  pthread_mutex_lock(&scanner->lock);
+
+  if(scanner->job == lst || scanner->spare == lst)
+	{
+	  if(scanner->job == lst)
+		scanner->job = NULL;
+	  else
+		scanner->spare = NULL;
+	  listing_free(lst);
+	}
+  else if(scanner->current == lst)
+	__atomic_store_n(&lst->cancelled, 1, __ATOMIC_RELEASE);
+  else
+	taken = 0;
+
+  pthread_mutex_unlock(&scanner->lock);
+
+  return taken;
+}
+
+// the pipe is readable, on the main thread
+static void
+scanner_on_note(void)
+{
+  char buff[64];
+
+  __atomic_store_n(&scanner->noted, 0, __ATOMIC_RELEASE);
+  while(read(scanner->notify[0], buff, sizeof(buff)) == sizeof(buff));
+
+  scanner->on_progress();
+}
+
+struct Scanner *scanner_setup(int (*fill)(struct Listing *lst),
+							  void (*on_progress)(void))
+{
+  struct Scanner *scn =
+	(struct Scanner*) calloc(1, sizeof(struct Scanner));
+
+  scn->fill = fill;
+  scn->on_progress = on_progress;
+
+  pthread_mutex_init(&scn->lock, NULL);
+  pthread_cond_init(&scn->wake, NULL);
+
+  if(pipe(scn->notify) < 0)
+	ErrorAndExit("couldn't set up the directory scanner\n");
+  fcntl(scn->notify[0], F_SETFL, O_NONBLOCK);
+  fcntl(scn->notify[1], F_SETFL, O_NONBLOCK);
+  watch_fd(scn->notify[0], scanner_on_note);
+
+  if(pthread_create(&scn->thread, NULL, scanner_loop, scn))
+	ErrorAndExit("couldn't start the directory scanner\n");
+
+  return scn;
+}
+
+void scanner_free(struct Scanner *scn)
+{
+  pthread_mutex_lock(&scn->lock);
+  scn->quit = 1;
+  if(scn->current)
+	__atomic_store_n(&scn->current->cancelled, 1, __ATOMIC_RELEASE);
+  if(scn->job)
+	listing_free(scn->job);
+  if(scn->spare)
+	listing_free(scn->spare);
+  scn->job = scn->spare = NULL;
+  pthread_cond_signal(&scn->wake);
+  pthread_mutex_unlock(&scn->lock);
+
+  pthread_join(scn->thread, NULL);
+
+  unwatch_fd(scn->notify[0]);
+  close(scn->notify[0]);
+  close(scn->notify[1]);
+  pthread_mutex_destroy(&scn->lock);
+  pthread_cond_destroy(&scn->wake);
+  free(scn);
+}
@@ -0,0 +1,45 @@
+#include "global.h"
+#include "listing.h"
+#include <pthread.h>
+
+#ifndef WERTYUIOPLKJHGFDSAZX
+#define WERTYUIOPLKJHGFDSAZX
+
+#define SCAN_NOTE_US 50000 // least time between two progress notes
+
+/* a thread filling listings off the main loop, one at a time. the
+ * main loop shows a listing while it fills and hears of the
+ * progress through a pipe it sleeps on (see watch_fd()) */
+struct Scanner
+{
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  int quit;
+
+  struct Listing *job;     // waiting for the thread
+  struct Listing *spare;   // a guess, filled when there's no job
+  struct Listing *current; // being filled
+
+  // fills lst on the scanner's thread, returns 0 if it got it all
+  int (*fill)(struct Listing *lst);
+  // runs on the main thread when listings have grown or finished
+  void (*on_progress)(void);
+
+  int notify[2];  // pipe, thread to main loop
+  int noted;      // a note is in the pipe, unread
+  long long last_note; // us, of the thread's latest
+};
+
+struct Scanner *scanner;
+
+void scanner_start(struct Listing *lst);
+void scanner_prefetch(struct Listing *lst);
+int  scanner_cancel(struct Listing *lst);
+void scanner_progress(struct Listing *lst);
+
+struct Scanner *scanner_setup(int (*fill)(struct Listing *lst),
+							  void (*on_progress)(void));
+void scanner_free(struct Scanner *scn);
+
+#endif
@@ -3,6 +3,7 @@
 #include "keyboards.h"
 #include "commands.h"
 #include "utils.h"
+#include "config.h"
 
 void
 songlist_simple_bar(void)
@@ -64,37 +65,41 @@ songlist_redraw_screen(void)
 
   WINDOW *win = specific_win(SONGLIST);  
 
-  int id;
-  char *title, *artist;
+  char pos[16], time[16];
+  struct FieldText fields[FIELD_NUM];
+  struct MetaInfo *meta;
+  int color;
+
+  memset(fields, 0, sizeof(fields));
+  fields[FIELD_POS].str = pos;
+  fields[FIELD_TIME].str = time;
+
   for(i = songlist->begin - 1; i < songlist->begin
 		+ height - 1 && i < songlist->length; i++)
 	{
-	  id = songlist->meta[i].id;
-	  title = songlist->meta[i].pretty_title;
-	  artist = songlist->meta[i].artist;
-
-	  // cursor in
-	  if(i + 1 == songlist->cursor)
-		{
-		  print_list_item(win, line++, 2, id, title, artist);
-		  continue;
-		}
-
-	  // selected
-	  if(songlist->selected[i] && !songlist->search_mode)
-		{
-		  print_list_item(win, line++, 9, id, title, artist);
-		  continue;
-		}
-		
-	  if(songlist->meta[i].id == songlist->current)
-		{
-		  print_list_item(win, line++, 1, id, title, artist);
-		}
+	  meta = songlist->meta + i;
+
+	  snprintf(pos, sizeof(pos), "%3i.", meta->id);
+	  snprintf(time, sizeof(time), "%02u:%02u",
+			   meta->duration / 60, meta->duration % 60);
+	  fields[FIELD_TITLE].str = meta->title;
+	  fields[FIELD_TITLE].info = &meta->title_info;
+	  fields[FIELD_ARTIST].str = meta->artist;
+	  fields[FIELD_ARTIST].info = &meta->artist_info;
+	  fields[FIELD_ALBUM].str = meta->album;
+	  fields[FIELD_ALBUM].info = &meta->album_info;
+
+	  if(i + 1 == songlist->cursor) // cursor in
+		color = 2;
+	  else if(songlist->selected[i] && !songlist->search_mode) // selected
+		color = 9;
+	  else if(meta->id == songlist->current)
+		color = 1;
 	  else
-		{
-		  print_list_item(win, line++, 0, id, title, artist);
-		}
+		color = 0;
+
+	  print_format_row(win, line++, color, &songlist->format,
+					   fields, &songlist->text);
 	}
 }
 
@@ -102,26 +107,28 @@ void
 songlist_update(void)
 {
   struct mpd_song *song;
+  struct MetaInfo *meta;
   
   if (!mpd_send_list_queue_meta(conn))
 	printErrorAndExit(conn);
 
+  text_pool_clear(&songlist->text);
+
   int i = 0;
   while ((song = mpd_recv_song(conn)) != NULL
 		 && i < MAX_SONGLIST_STORE_LENGTH)
 	{
-	  pretty_copy(songlist->meta[i].title,
-					get_song_tag(song, MPD_TAG_TITLE),
-					512, -1);
-	  pretty_copy(songlist->meta[i].pretty_title,
-					get_song_tag(song, MPD_TAG_TITLE),
-					128, 26);
-	  pretty_copy(songlist->meta[i].artist,
-					get_song_tag(song, MPD_TAG_ARTIST),
-					128, 14);	  
-	  pretty_copy(songlist->meta[i].album,
-					get_song_tag(song, MPD_TAG_ALBUM),
-					128, -1);
+	  meta = &songlist->meta[i];
+	  utf8_copy(meta->title, sizeof(meta->title),
+				get_song_tag(song, MPD_TAG_TITLE));
+	  utf8_copy(meta->artist, sizeof(meta->artist),
+				get_song_tag(song, MPD_TAG_ARTIST));
+	  utf8_copy(meta->album, sizeof(meta->album),
+				get_song_tag(song, MPD_TAG_ALBUM));
+	  text_measure(&songlist->text, &meta->title_info, meta->title);
+	  text_measure(&songlist->text, &meta->artist_info, meta->artist);
+	  text_measure(&songlist->text, &meta->album_info, meta->album);
+	  songlist->meta[i].duration = mpd_song_get_duration(song);
 	  songlist->meta[i].id = i + 1;
 	  ++i;
 	  mpd_song_free(song);
@@ -365,6 +372,13 @@ struct Songlist* songlist_setup(void)
   slist->crt_tag_id = 0;
   slist->key[0] = '\0';
 
+  // a broken template from the user falls back to the default
+  if(row_format_compile(&slist->format, config->songlist_format) < 0)
+	row_format_compile(&slist->format, DEFAULT_SONGLIST_FORMAT);
+
+  slist->text.bound = NULL;
+  slist->text.length = slist->text.size = 0;
+
   // window mode setup
   slist->wmode.size = 7;
   slist->wmode.wins = (struct WindowUnit**)
@@ -383,6 +397,7 @@ struct Songlist* songlist_setup(void)
 
 void songlist_free(struct Songlist *slist)
 {
+  text_pool_free(&slist->text);
   free(slist->wmode.wins);
   free(slist);
 }
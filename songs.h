@@ -1,5 +1,7 @@
 #include "global.h"
 #include "windows.h"
+#include "format.h"
+#include "text.h"
 
 #ifndef LKAJDSFOIAJFNC98I93
 #define LKAJDSFOIAJFNC98I93
@@ -9,7 +11,12 @@ struct MetaInfo
   char album[128];
   char artist[128];
   char title[512];
-  char pretty_title[128];
+  unsigned duration; // in seconds
+
+  // measured when the queue is fetched
+  struct TextInfo album_info;
+  struct TextInfo artist_info;
+  struct TextInfo title_info;
   
   int id;
 };
@@ -37,6 +44,9 @@ struct Songlist
   int cursor;
   int current; // current playing song id
 
+  struct RowFormat format; // how a song is shown in the list
+  struct TextPool text; // cluster boundaries of the meta strings
+
   struct WinMode wmode; // windows in this mode
 };
 
@@ -0,0 +1,114 @@
+#include "suffixes.h"
+#include "utils.h"
+
+// when mpd won't tell, those it's mostly built with
+static const char *fallback[] =
+  {
+	"mp3", "flac", "ogg", "oga", "opus", "wav", "wma", "ape", "m4a",
+	"mp4", "aac", "wv", "dsf", "dff", "mpc", "aiff", "aif", NULL
+  };
+
+// suffix's slot, or the empty one it would go in
+static int
+find_slot(const struct SuffixTable *table, const char *suffix)
+{
+  unsigned mask = table->nslot - 1, i = hash_string(suffix) & mask;
+
+  while(table->slot[i][0] && strcmp(table->slot[i], suffix))
+	i = (i + 1) & mask;
+
+  return i;
+}
+
+/* lower case suffix into buff, 0 if it's too long to be one. mpd
+   compares them ignoring the case too */
+static int
+fold_suffix(char *buff, const char *suffix)
+{
+  int i;
+
+  for(i = 0; suffix[i]; i++)
+	{
+	  if(i == SUFFIX_LEN - 1)
+		return 0;
+	  buff[i] = tolower((unsigned char)suffix[i]);
+	}
+  buff[i] = '\0';
+
+  return i > 0;
+}
+
+static void
+insert(struct SuffixTable *table, const char *suffix)
+{
+  char (*old)[SUFFIX_LEN] = table->slot;
+  char buff[SUFFIX_LEN];
+  int i, n = table->nslot, s;
+
+  if(!fold_suffix(buff, suffix))
+	return;
+
+  if(2 * (table->count + 1) > table->nslot)
+	{
+	  table->nslot = n ? n * 2 : 64;
+	  table->slot = calloc(table->nslot, SUFFIX_LEN);
+	  for(i = 0; i < n; i++)
+		if(old[i][0])
+		  strcpy(table->slot[find_slot(table, old[i])], old[i]);
+	  free(old);
+	}
+
+  s = find_slot(table, buff);
+  if(table->slot[s][0] == '\0') // several decoders share suffixes
+	{
+	  strcpy(table->slot[s], buff);
+	  table->count++;
+	}
+}
+
+/* ask mpd's "decoders" once, it's what the database is built by.
+   an older or refusing mpd leaves the fallback list */
+void
+suffix_table_load(struct SuffixTable *table, struct mpd_connection *conn)
+{
+  struct mpd_pair *pair;
+  int i;
+
+  memset(table, 0, sizeof(struct SuffixTable));
+
+  if(mpd_send_command(conn, "decoders", NULL))
+	{
+	  while((pair = mpd_recv_pair_named(conn, "suffix")) != NULL)
+		{
+		  insert(table, pair->value);
+		  mpd_return_pair(conn, pair);
+		}
+	}
+
+  if(!mpd_response_finish(conn))
+	mpd_connection_clear_error(conn);
+
+  if(table->count == 0)
+	for(i = 0; fallback[i]; i++)
+	  insert(table, fallback[i]);
+}
+
+// whether the suffix of name is one of them, one probe mostly
+int
+suffix_table_has(const struct SuffixTable *table, const char *name)
+{
+  const char *dot = strrchr(name, '.');
+  char buff[SUFFIX_LEN];
+
+  if(dot == NULL || table->count == 0 || !fold_suffix(buff, dot + 1))
+	return 0;
+
+  return table->slot[find_slot(table, buff)][0] != '\0';
+}
+
+void
+suffix_table_free(struct SuffixTable *table)
+{
+  free(table->slot);
+  memset(table, 0, sizeof(struct SuffixTable));
+}
@@ -0,0 +1,22 @@
+#include "global.h"
+
+#ifndef YHNUJMIKOLPTGBRFVEDC
+#define YHNUJMIKOLPTGBRFVEDC
+
+#define SUFFIX_LEN 16 // bytes, with the '\0', longer ones are no format
+
+/* the file name suffixes mpd has a decoder for, lower case, in an
+ * open addressing table at most half full. it's filled once at
+ * setup and only read after, also by the scanner's thread */
+struct SuffixTable
+{
+  char (*slot)[SUFFIX_LEN]; // "" for an empty one
+  int nslot; // a power of 2
+  int count;
+};
+
+void suffix_table_load(struct SuffixTable *table, struct mpd_connection *conn);
+int  suffix_table_has(const struct SuffixTable *table, const char *name);
+void suffix_table_free(struct SuffixTable *table);
+
+#endif
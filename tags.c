@@ -0,0 +1,96 @@
+#include "tags.h"
+#include "utils.h"
+
+static unsigned
+hash_uri(const char *uri)
+{
+  return hash_string(uri) % TAG_BUCKETS;
+}
+
+struct SongTags *
+tag_cache_find(struct TagCache *cache, const char *uri)
+{
+  struct SongTags *tags = cache->bucket[hash_uri(uri)];
+
+  while(tags && strcmp(tags->uri, uri))
+	tags = tags->next;
+
+  return tags;
+}
+
+/* keep what mpd said of uri, song NULL when it doesn't have it.
+   the texts are sanitized as the songlist's are */
+struct SongTags *
+tag_cache_put(struct TagCache *cache, const char *uri,
+			  const struct mpd_song *song)
+{
+  char title[512] = "", artist[128] = "", album[128] = "";
+  int lens[4];
+  struct SongTags *tags;
+  unsigned h;
+  char *pt;
+
+  if((tags = tag_cache_find(cache, uri)) != NULL)
+	return tags;
+
+  if(cache->count >= MAX_TAGGED_SONGS)
+	tag_cache_clear(cache);
+
+  if(song)
+	{
+	  utf8_copy(title, sizeof(title), get_song_tag(song, MPD_TAG_TITLE));
+	  utf8_copy(artist, sizeof(artist), get_song_tag(song, MPD_TAG_ARTIST));
+	  utf8_copy(album, sizeof(album), get_song_tag(song, MPD_TAG_ALBUM));
+	}
+
+  lens[0] = strlen(uri) + 1;
+  lens[1] = strlen(title) + 1;
+  lens[2] = strlen(artist) + 1;
+  lens[3] = strlen(album) + 1;
+
+  tags = (struct SongTags*) malloc(sizeof(struct SongTags)
+								   + lens[0] + lens[1] + lens[2] + lens[3]);
+  pt = (char*) (tags + 1);
+  tags->uri = memcpy(pt, uri, lens[0]);
+  tags->title = memcpy(pt += lens[0], title, lens[1]);
+  tags->artist = memcpy(pt += lens[1], artist, lens[2]);
+  tags->album = memcpy(pt += lens[2], album, lens[3]);
+  tags->duration = song ? mpd_song_get_duration(song) : 0;
+  tags->known = song != NULL;
+
+  text_measure(&cache->text, &tags->title_info, tags->title);
+  text_measure(&cache->text, &tags->artist_info, tags->artist);
+  text_measure(&cache->text, &tags->album_info, tags->album);
+
+  h = hash_uri(uri);
+  tags->next = cache->bucket[h];
+  cache->bucket[h] = tags;
+  cache->count++;
+
+  return tags;
+}
+
+void
+tag_cache_clear(struct TagCache *cache)
+{
+  struct SongTags *tags, *next;
+  int i;
+
+  for(i = 0; i < TAG_BUCKETS; i++)
+	for(tags = cache->bucket[i]; tags; tags = next)
+	  {
+		next = tags->next;
+		free(tags);
+	  }
+
+  memset(cache->bucket, 0, sizeof(cache->bucket));
+  cache->count = 0;
+  text_pool_clear(&cache->text);
+}
+
+void
+tag_cache_free(struct TagCache *cache)
+{
+  tag_cache_clear(cache);
+  text_pool_free(&cache->text);
+}
@@ -0,0 +1,41 @@
+#include "global.h"
+#include "text.h"
+
+#ifndef WSXQAZEDCRFVTGBYHNUJ
+#define WSXQAZEDCRFVTGBYHNUJ
+
+#define TAG_BUCKETS 4096
+#define MAX_TAGGED_SONGS 20000 // the cache starts over past it
+
+/* a song's tags for the directory's columns, all its strings come
+ * in the same allocation as itself */
+struct SongTags
+{
+  char *uri;
+  char *title, *artist, *album;
+  unsigned duration; // in seconds
+  int known; // 0 for a file mpd doesn't have, it's shown by its name
+
+  // measured when they come in
+  struct TextInfo title_info;
+  struct TextInfo artist_info;
+  struct TextInfo album_info;
+
+  struct SongTags *next; // in the bucket
+};
+
+// the tags of the songs shown so far, by uri
+struct TagCache
+{
+  struct SongTags *bucket[TAG_BUCKETS];
+  int count;
+  struct TextPool text;
+};
+
+struct SongTags *tag_cache_find(struct TagCache *cache, const char *uri);
+struct SongTags *tag_cache_put(struct TagCache *cache, const char *uri,
+							   const struct mpd_song *song);
+void tag_cache_clear(struct TagCache *cache);
+void tag_cache_free(struct TagCache *cache);
+
+#endif
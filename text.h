@@ -0,0 +1,44 @@
+#include "global.h"
+
+#ifndef MZNXBCVLAKSJDHFGPQOW
+#define MZNXBCVLAKSJDHFGPQOW
+
+/* end of a grapheme cluster: its byte offset and the display
+ * column right after it */
+struct TextBound
+{
+  unsigned short offset;
+  unsigned short col;
+};
+
+// boundaries of all the strings measured for one store
+struct TextPool
+{
+  struct TextBound *bound;
+  int length;
+  int size;
+};
+
+/* a string measured once when it's ingested, so any cut of it
+ * is a binary search rather than a decoding */
+struct TextInfo
+{
+  int len;    // bytes
+  int width;  // display columns
+  int nbound; // clusters, 0 for plain ascii, one byte a column
+  int bound;  // the first of them in TextPool.bound
+};
+
+int  char_width(unsigned int ucs);
+int  utf8_decode(const char *str, unsigned int *ucs);
+int  utf8_width(const char *str, int len);
+int  utf8_fit(char *dst, int size, const char *src, int cols);
+int  utf8_copy(char *dst, int size, const char *src);
+
+void text_measure(struct TextPool *pool, struct TextInfo *info, const char *str);
+int  text_fit(char *dst, int size, const char *str, const struct TextInfo *info,
+			  const struct TextPool *pool, int cols);
+void text_pool_clear(struct TextPool *pool);
+void text_pool_free(struct TextPool *pool);
+
+#endif
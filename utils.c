@@ -26,25 +26,130 @@ printErrorAndExit(struct mpd_connection *conn)
   exit(EXIT_FAILURE);
 }
 
+/* file descriptors the main loop sleeps on, a handler is called
+   when its fd gets readable. stdin has none, the keys are read
+   by the keymaps */
+#define MAX_WATCHED_FDS 8
+static struct pollfd watched_fds[MAX_WATCHED_FDS];
+static void (*watched_handlers[MAX_WATCHED_FDS])(void);
+static int watched_num = 0;
+
+static long long wake_deadline = 0; // 0 for none
+
+int
+watch_fd(int fd, void (*on_ready)(void))
+{
+  if(watched_num >= MAX_WATCHED_FDS)
+	return -1;
+
+  watched_fds[watched_num].fd = fd;
+  watched_fds[watched_num].events = POLLIN;
+  watched_handlers[watched_num] = on_ready;
+  watched_num++;
+
+  return 0;
+}
+
+void
+unwatch_fd(int fd)
+{
+  int i;
+
+  for(i = 0; i < watched_num; i++)
+	if(watched_fds[i].fd == fd)
+	  {
+		watched_num--;
+		watched_fds[i] = watched_fds[watched_num];
+		watched_handlers[i] = watched_handlers[watched_num];
+		return;
+	  }
+}
+
+/* ask the next smart_sleep() to return by the time us (of
+   get_monotonic_us()), the earliest of the asks wins */
+void
+wake_at(long long us)
+{
+  if(wake_deadline == 0 || us < wake_deadline)
+	wake_deadline = us;
+}
+
 /* the principle is that: if the keyboard events
  * occur frequently, then adjust the update rate
  * higher, if the keyboard is just idle, keep it
- * low. */
-void
+ * low. 
+ * the sleep is cut short by a key, a watched fd or a
+ * wake_at() deadline. returns 1 if the interface is due
+ * to check for updates, 0 if we only woke for a deadline */
+int
 smart_sleep(void)
 {
   static int us = INTERVAL_MAX_UNIT;
+  static long long ui_deadline = 0;
+  long long now, deadline;
+  struct timespec ts;
+  int i, ready;
 
   if(interval_level)
 	{
 	  us = INTERVAL_MIN_UNIT +
 		(interval_level - 1) * 10000;
 	  interval_level = 0;
+	  ui_deadline = 0;
 	}
-  else
-	us = us < INTERVAL_MAX_UNIT ? us + INTERVAL_INCREMENT : us;
 
-  usleep(us);
+  now = get_monotonic_us();
+  if(ui_deadline <= now)
+	{
+	  ui_deadline = now + us;
+	  us = us < INTERVAL_MAX_UNIT ? us + INTERVAL_INCREMENT : us;
+	}
+
+  deadline = ui_deadline;
+  if(wake_deadline && wake_deadline < deadline)
+	deadline = wake_deadline;
+  wake_deadline = 0;
+
+  deadline = deadline > now ? deadline - now : 0;
+  ts.tv_sec = deadline / 1000000;
+  ts.tv_nsec = deadline % 1000000 * 1000;
+
+  ready = ppoll(watched_fds, watched_num, &ts, NULL);
+  if(ready < 0) // a signal, such as a resize
+	return 1;
+
+  for(i = 0; ready > 0 && i < watched_num; i++)
+	if(watched_fds[i].revents)
+	  {
+		if(watched_fds[i].fd == STDIN_FILENO)
+		  ui_deadline = 0; // a key is in, the interface is due
+		else if(watched_handlers[i])
+		  watched_handlers[i]();
+	  }
+
+  return get_monotonic_us() >= ui_deadline;
+}
+
+long long
+get_monotonic_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// FNV-1a, the tables mask or mod it to their size
+unsigned
+hash_string(const char *str)
+{
+  unsigned h = 2166136261u;
+
+  while(*str)
+	h = (h ^ (unsigned char)*str++) * 16777619u;
+
+  return h;
 }
 
 void my_finishCommand(struct mpd_connection *conn) {
@@ -129,47 +234,19 @@ char *is_substring_ignorecase(const char *main, char *sub)
   char lower_main[64], lower_sub[64];
   int i;
 
-  for(i = 0; main[i] && i < 64; i++)
+  for(i = 0; main[i] && i < 63; i++)
   	lower_main[i] = isalpha(main[i]) ?
   	  (islower(main[i]) ? main[i] : (char)tolower(main[i])) : main[i];
   lower_main[i] = '\0';
 
-  for(i = 0; sub[i] && i < 64; i++)
+  for(i = 0; sub[i] && i < 63; i++)
   	lower_sub[i] = isalpha(sub[i]) ?
   	  (islower(sub[i]) ? sub[i] : (char)tolower(sub[i])) : sub[i];
   lower_sub[i] = '\0';
 
-  return strstr(lower_main, lower_sub);
-}
-
-void
-pretty_copy(char *string, const char * tag, int size, int width)
-{
-  static int i, unic, asci;
-
-  for(i = unic = asci = 0; tag[i] != '\0' && i < size - 1; i++)
-	{
-	  if(isascii((int)tag[i]))
-		asci ++;
-	  else
-		unic ++;
-	  string[i] = tag[i];
-	}
-
-  unic /= 3;
-
-  if(width > 0)
-	{
-	  /* if the string too long, we interupt it
-		 and profix ... to it */
-	  if(width < 2*unic + asci)
-		{
-		  strncpy(string + width - 3, "...", 4);
-		  return;
-		}
-	}
-
-  string[i] = '\0';
+  // point into the caller's string, not into our stack copy
+  char *p = strstr(lower_main, lower_sub);
+  return p ? (char*)main + (p - lower_main) : NULL;
 }
 
 /* this style of scrolling keeps the cursor in
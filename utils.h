@@ -5,7 +5,12 @@
  *************************************/
 void ErrorAndExit(const char *message);
 void printErrorAndExit(struct mpd_connection *conn);
-void smart_sleep(void);
+int  watch_fd(int fd, void (*on_ready)(void));
+void unwatch_fd(int fd);
+void wake_at(long long us);
+int  smart_sleep(void);
+long long get_monotonic_us(void);
+unsigned hash_string(const char *str);
 void my_finishCommand(struct mpd_connection *conn);
 struct mpd_connection* setup_connection(void);
 struct mpd_status * getStatus(struct mpd_connection *conn);
@@ -13,7 +18,6 @@ struct mpd_status* init_mpd_status(struct mpd_connection *conn);
 const char * get_song_format(const struct mpd_song *song);
 const char * get_song_tag(const struct mpd_song *song, enum mpd_tag_type type);
 char *is_substring_ignorecase(const char *main, char *sub);
-void pretty_copy(char *string, const char * tag, int size, int width);
 void scroll_line_shift_style
 (int *cursor, int *begin, const int total, const int height, const int lines);
 
@@ -1,196 +1,682 @@
 #include "visualizer.h"
 #include "windows.h"
+#include "utils.h"
+#include "config.h"
+#include <sys/ioctl.h>
 
 /** Music Visualizer **/
 void
-get_fifo_id(void)
+ring_write(struct SampleRing *ring, const float *src, int n)
 {
-  const char *fifo_path = visualizer->fifo_file;
-  int id = -1;
-  
-  if((id = open(fifo_path , O_RDONLY | O_NONBLOCK)) < 0)
-	debug("couldn't open the fifo file");
+  const unsigned long head = ring->head; // only we write it
+  const int pos = head & (ring->size - 1);
+  const int first = n < ring->size - pos ? n : ring->size - pos;
 
-  visualizer->fifo_id = id;
+  memcpy(ring->data + pos, src, first * sizeof(float));
+  memcpy(ring->data, src + first, (n - first) * sizeof(float));
+
+  // publish the samples only after they are in place
+  __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
 }
 
+/* copy the n samples ending at end to dst, returns 0 if they
+   are not all in the ring (yet or any more). a copy overrun by
+   the writer is retried */
 int
-get_fifo_output_id(void)
+ring_read(struct SampleRing *ring, float *dst, int n, unsigned long end)
 {
-	struct mpd_output *output;
-	int ret = -1, id;
-	const char *name;
+  unsigned long head, after;
+  int pos, first;
 
-	mpd_send_outputs(conn);
+  do
+	{
+	  head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	  if(end > head || end < (unsigned long)n
+		 || head - end > (unsigned long)(ring->size - n))
+		return 0;
+
+	  pos = (end - n) & (ring->size - 1);
+	  first = n < ring->size - pos ? n : ring->size - pos;
+	  memcpy(dst, ring->data + pos, first * sizeof(float));
+	  memcpy(dst + first, ring->data, (n - first) * sizeof(float));
+
+	  // the copy's loads must be done before head is looked at again
+	  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+	  after = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	}
+  while(after - end > (unsigned long)(ring->size - n));
 
-	while ((output = mpd_recv_output(conn)) != NULL) {
-		id = mpd_output_get_id(output);
-		name = mpd_output_get_name(output);
+  return n;
+}
+
+/* room for latency us of samples at rate, the frames shown are
+   that far behind the head. returns the latency it holds, less
+   than asked only past RING_MAX_SIZE */
+static long long
+ring_setup(struct SampleRing *ring, float rate, long long latency)
+{
+  const double per_us = 2 * rate / 1e6; // stereo
+  const long long need = latency * per_us + RING_SLACK;
+
+  for(ring->size = RING_MIN_SIZE; ring->size < need
+		&& ring->size < RING_MAX_SIZE; ring->size *= 2);
+  ring->data = (float*) calloc(ring->size, sizeof(float));
 
-		if (mpd_output_get_enabled(output)
-			&& !strstr(name, "FIFO"))
-		  ret = id;
+  if(need > ring->size)
+	latency = (ring->size - RING_SLACK) / per_us;
 
-		mpd_output_free(output);
+  return latency;
+}
+
+// note the time the sample at pos entered the fifo
+void
+ring_stamp(struct SampleRing *ring, unsigned long pos, long long us)
+{
+  const unsigned long i = ring->nstamp + 1; // only we write it
+
+  ring->stamp[i % RING_STAMPS].pos = pos;
+  ring->stamp[i % RING_STAMPS].us = us;
+  __atomic_store_n(&ring->nstamp, i, __ATOMIC_RELEASE);
+}
+
+/* position in the ring of the sample that entered the fifo at
+   time us, worked out from the latest stamp. rate is samples a
+   second, all channels counted */
+unsigned long
+ring_position_at(struct SampleRing *ring, long long us, float rate)
+{
+  const unsigned long i = __atomic_load_n(&ring->nstamp, __ATOMIC_ACQUIRE);
+  const struct SampleStamp stamp = ring->stamp[i % RING_STAMPS];
+  const long long back = (stamp.us - us) * rate / 1e6;
+
+  if(i == 0)
+	return 0;
+
+  if(back < 0) // not come yet, the latest is the best we have
+	return stamp.pos;
+
+  return (unsigned long)back < stamp.pos ? stamp.pos - back : 0;
+}
+
+/* drains the fifo as fast as mpd fills it, so the pipe never
+   backs up whatever the frame rate of the screen is */
+static void *
+fifo_reader(void *arg)
+{
+  struct Visualizer *vis = (struct Visualizer*)arg;
+  struct pollfd pfd = {vis->fifo_id, POLLIN, 0};
+  const int frame = sample_bytes(vis->format) * vis->channels;
+  const float bytes_us = vis->rate * frame / 1e6;
+  int32_t raw[2048]; // aligned for any of the formats
+  float out[8192]; // as stereo, the most is s16 mono doubled
+  int carry = 0, n, whole, backlog;
+
+  while(__atomic_load_n(&vis->reading, __ATOMIC_ACQUIRE))
+	{
+	  if(poll(&pfd, 1, 100) <= 0)
+		continue;
+
+	  n = read(vis->fifo_id, (char*)raw + carry, sizeof(raw) - carry);
+	  if(n <= 0)
+		{
+		  // no writer, mpd is paused or stopped
+		  usleep(2e4);
+		  continue;
+		}
+
+	  // only whole frames go in, keeping the channels in place
+	  n += carry;
+	  whole = n - n % frame;
+	  sample_convert(out, raw, whole / frame, vis->format, vis->channels);
+	  ring_write(&vis->ring, out, 2 * (whole / frame));
+	  carry = n - whole;
+	  memmove(raw, (char*)raw + whole, carry);
+
+	  /* what is still in the pipe was written after what we just
+		 got, by the time it takes to play */
+	  if(ioctl(vis->fifo_id, FIONREAD, &backlog) < 0)
+		backlog = 0;
+	  ring_stamp(&vis->ring, vis->ring.head,
+				 get_monotonic_us() - (long long)((backlog + carry) / bytes_us));
 	}
 
-	if(ret == -1)
-	  debug("output disenabled.");
-	
-	mpd_response_finish(conn);
+  return NULL;
+}
+
+/* a format of mpd, "rate:bits:channels" such as "96000:24:2",
+   '*' takes the usual value. returns 0 if we can read it */
+int
+parse_fifo_format(const char *str, float *rate, int *format, int *channels)
+{
+  char r[16], b[16], c[16];
+
+  if(sscanf(str, "%15[^:]:%15[^:]:%15s", r, b, c) != 3)
+	return -1;
+
+  *rate = strcmp(r, "*") ? atof(r) : 44100;
+  *channels = strcmp(c, "*") ? atoi(c) : 2;
+
+  if(strcmp(b, "16") == 0 || strcmp(b, "*") == 0)
+	*format = SAMPLE_S16;
+  else if(strcmp(b, "24") == 0)
+	*format = SAMPLE_S24;
+  else if(strcmp(b, "32") == 0)
+	*format = SAMPLE_S32;
+  else if(strcmp(b, "f") == 0)
+	*format = SAMPLE_F32;
+  else
+	return -1; // dsd and 8 bits aren't worth a meter
 
-	return ret;
+  return *rate > 0 && *channels > 0 && *channels <= 8 ? 0 : -1;
 }
 
+// value of a line like: path "/tmp/mpd.fifo"
+static int
+conf_value(const char *line, const char *key, char *value, int size)
+{
+  const int len = strlen(key);
+  const char *begin, *end;
+
+  if(strncmp(line, key, len) || !isspace(line[len])
+	 || !(begin = strchr(line + len, '"'))
+	 || !(end = strchr(begin + 1, '"')))
+	return 0;
+
+  snprintf(value, size, "%.*s", (int)(end - begin - 1), begin + 1);
+  return 1;
+}
+
+/* path and format of the fifo output in mpd.conf, the one
+   called name if it's given. returns 0 if there is one */
+static int
+fifo_from_mpd_conf(const char *name, char *path, int path_size,
+				   char *format, int format_size)
+{
+  const char *home = getenv("HOME"), *xdg = getenv("XDG_CONFIG_HOME");
+  char files[5][512], line[1024], *pt;
+  char type[32], oname[256], opath[512], oformat[64], global[64];
+  int i, in_output = 0, found = 0;
+  FILE *fp = NULL;
+
+  // where mpd itself looks for it
+  snprintf(files[0], 512, "%s/mpd/mpd.conf", xdg ? xdg : "");
+  snprintf(files[1], 512, "%s/.config/mpd/mpd.conf", home ? home : "");
+  snprintf(files[2], 512, "%s/.mpdconf", home ? home : "");
+  snprintf(files[3], 512, "%s/.mpd/mpd.conf", home ? home : "");
+  snprintf(files[4], 512, "/etc/mpd.conf");
+
+  for(i = 0; i < 5 && fp == NULL; i++)
+	fp = fopen(files[i], "r");
+  if(fp == NULL)
+	return -1;
+
+  global[0] = '\0';
+  while(!found && fgets(line, sizeof(line), fp))
+	{
+	  if((pt = strchr(line, '#')))
+		*pt = '\0';
+	  for(pt = line; isspace(*pt); pt++);
+
+	  if(strncmp(pt, "audio_output", 12) == 0 && strchr(pt, '{'))
+		{
+		  in_output = 1;
+		  type[0] = oname[0] = opath[0] = oformat[0] = '\0';
+		}
+	  else if(in_output && *pt == '}')
+		{
+		  in_output = 0;
+		  found = strcmp(type, "fifo") == 0 && opath[0]
+			&& (name == NULL || strcmp(name, oname) == 0);
+		}
+	  else if(in_output)
+		{
+		  conf_value(pt, "type", type, sizeof(type));
+		  conf_value(pt, "name", oname, sizeof(oname));
+		  conf_value(pt, "path", opath, sizeof(opath));
+		  conf_value(pt, "format", oformat, sizeof(oformat));
+		}
+	  else
+		conf_value(pt, "audio_output_format", global, sizeof(global));
+	}
 
+  fclose(fp);
+
+  if(!found)
+	return -1;
+
+  snprintf(path, path_size, "%s", opath);
+  snprintf(format, format_size, "%s", oformat[0] ? oformat : global);
+  return 0;
+}
+
+/* find where and how mpd writes the samples. the fifo output is
+   the one of the "fifo" plugin, its path and format are taken
+   from its attributes if mpd publishes them, else from the
+   mpd.conf that defines it. fifo_path and fifo_format of our
+   own config win over both */
 void
-fifo_output_update(void)
+fifo_discover(void)
 {
-  int fifo_output_id = get_fifo_output_id();
+  struct Visualizer *vis = visualizer;
+  struct mpd_output *output;
+  char name[256] = "", path[512] = "", format[64] = "";
+  const char *plugin, *value;
 
-  if(fifo_output_id != -1)
+  mpd_send_outputs(conn);
+  while((output = mpd_recv_output(conn)) != NULL)
 	{
-	  mpd_run_disable_output(conn, fifo_output_id);
-	  usleep(3e4);
-	  mpd_run_enable_output(conn, fifo_output_id);
+#if LIBMPDCLIENT_CHECK_VERSION(2, 18, 0)
+	  plugin = mpd_output_get_plugin(output);
+#else
+	  plugin = NULL;
+#endif
+	  if(name[0] == '\0' && (plugin ? strcmp(plugin, "fifo") == 0
+		  : is_substring_ignorecase(mpd_output_get_name(output), "fifo") != NULL))
+		{
+		  snprintf(name, sizeof(name), "%s", mpd_output_get_name(output));
+#if LIBMPDCLIENT_CHECK_VERSION(2, 16, 0)
+		  if((value = mpd_output_get_attribute(output, "path")))
+			snprintf(path, sizeof(path), "%s", value);
+		  if((value = mpd_output_get_attribute(output, "format")))
+			snprintf(format, sizeof(format), "%s", value);
+#endif
+		}
+	  mpd_output_free(output);
 	}
+
+  // mpd may keep its outputs from us, mpd.conf and our config remain
+  if(!mpd_response_finish(conn))
+	{
+	  if(mpd_connection_get_error(conn) != MPD_ERROR_SERVER)
+		printErrorAndExit(conn);
+	  mpd_connection_clear_error(conn);
+	}
+
+  if(path[0] == '\0')
+	fifo_from_mpd_conf(name[0] ? name : NULL, path, sizeof(path),
+					   format, sizeof(format));
+
+  if(config->fifo_path[0])
+	snprintf(path, sizeof(path), "%s", config->fifo_path);
+  if(config->fifo_format[0])
+	snprintf(format, sizeof(format), "%s", config->fifo_format);
+
+  if(path[0])
+	snprintf(vis->fifo_file, sizeof(vis->fifo_file), "%s", path);
+
+  if(format[0] && parse_fifo_format(format, &vis->rate, &vis->format,
+									&vis->channels) < 0)
+	debug("unknown fifo format");
 }
 
 void
-print_uv_meter(int bars, int max)
+get_fifo_id(void)
+{
+  const char *fifo_path = visualizer->fifo_file;
+  char message[64];
+  long long latency;
+  int id = -1;
+
+  fifo_discover();
+
+  // the ring goes by the rate just found
+  latency = ring_setup(&visualizer->ring, visualizer->rate,
+					   visualizer->latency);
+  if(latency < visualizer->latency)
+	{
+	  snprintf(message, sizeof(message), "output latency cut to %lli ms",
+			   latency / 1000);
+	  debug(message);
+	  visualizer->latency = latency;
+	}
+
+  if((id = open(fifo_path , O_RDONLY | O_NONBLOCK)) < 0)
+	debug("couldn't open the fifo file");
+
+  visualizer->fifo_id = id;
+
+  if(id >= 0)
+	{
+	  visualizer->reading = 1;
+	  if(pthread_create(&visualizer->reader, NULL,
+						fifo_reader, visualizer) != 0)
+		visualizer->reading = 0;
+	}
+}
+
+#define METER_RANGE_DB 48.f // the left end of the scale, in dBFS
+#define METER_VU_ZERO -18.f // dBFS at 0 VU
+#define METER_HOT -6.f
+
+static const char *eighths[] =
+  {"", "▏", "▎", "▍", "▌", "▋", "▊", "▉", "█"};
+
+// column, in eighths, of a dBFS level on a scale of cols
+static int
+meter_column(float db, int cols)
+{
+  const float x = (db + METER_RANGE_DB) / METER_RANGE_DB;
+  return x <= 0 ? 0 : x >= 1 ? 8 * cols : x * 8 * cols;
+}
+
+/* a row a channel: the VU level as the bar, green up to 0 VU,
+   yellow on to METER_HOT and red beyond, the PPM as a mark
+   and its reading in dBFS at the end */
+void
+draw_stereo_meter(float *buf, int frames, float dt)
 {
-  int i, long_tail = 0;
-  
   WINDOW *win = specific_win(VISUALIZER);
+  struct Meter *m = visualizer->meter;
+  const int cols = win->_maxx - 8, zero = meter_column(METER_VU_ZERO, cols),
+	hot = meter_column(METER_HOT, cols);
+  struct Levels lv;
+  int c, x, fill, mark, pair;
 
-  int width = win->_maxx - 1;
+  meter_measure(m, buf, frames, &lv);
+  meter_update(m, &lv, dt);
 
-  if(max == 0)
-	bars = max = 1;
-  
-  while(bars > width)
+  for(c = 0; c < 2; c++)
 	{
-	  max = bars - width;
-	  bars = width - max;
-	  long_tail = 1;
+	  mvwprintw(win, c, 0, "%c", c ? 'R' : 'L');
+
+	  fill = meter_column(m->vu[c], cols);
+	  for(x = 0; 8 * x < fill; x++)
+		{
+		  pair = 8 * x < zero ? 4 : 8 * x < hot ? 0 : 3;
+		  wattron(win, my_color_pairs[pair]);
+		  mvwaddstr(win, c, 2 + x,
+					eighths[fill - 8 * x < 8 ? fill - 8 * x : 8]);
+		  wattroff(win, my_color_pairs[pair]);
+		}
+
+	  mark = meter_column(m->ppm[c], cols) / 8;
+	  if(m->ppm[c] > -METER_RANGE_DB && mark >= fill / 8)
+		{
+		  wattron(win, my_color_pairs[2]);
+		  mvwaddstr(win, c, 2 + (mark < cols ? mark : cols - 1), "|");
+		  wattroff(win, my_color_pairs[2]);
+		}
+
+	  if(m->ppm[c] > -METER_RANGE_DB)
+		mvwprintw(win, c, win->_maxx - 5, "%5.1f", m->ppm[c]);
+	  else
+		mvwprintw(win, c, win->_maxx - 5, " -inf");
 	}
-  
-  if(max > width)
-	max = width;
+}
+
+static const char *blocks[] =
+  {" ", "▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+
+/* a bar a band, every cell of it in eighths of a row so the
+   tops move smoothly. the held peak floats over the bar */
+void
+draw_spectrum(float *buf, float dt)
+{
+  WINDOW *win = specific_win(VISUALIZER);
+  struct Spectrum *sp = visualizer->spectrum;
+  const int rows = win->_maxy + 1;
+  const int nbands = (win->_maxx + 2) / 2; // a column and a gap each
+  int b, r, fill, peak;
+
+  if(nbands != sp->nbands || visualizer->rate != sp->rate)
+	spectrum_set_bands(sp, nbands, visualizer->rate);
 
-  wprintw(win, "_");
+  spectrum_analyze(sp, buf, dt);
 
-  if(long_tail)
+  for(b = 0; b < sp->nbands; b++)
 	{
-	  const char *trail = "-/|\\";
-	  static int j = 0;
+	  fill = sp->level[b] * rows * 8;
+	  peak = sp->peak[b] * rows * 8;
 
 	  wattron(win, my_color_pairs[0]);
-	  for(i = 0; i < bars; i++)
-		wprintw(win, "%c", trail[j]);
-	  wattron(win, my_color_pairs[0]);
+	  for(r = 0; r < rows && fill > 8 * r; r++)
+		mvwaddstr(win, rows - 1 - r, 2 * b,
+				  blocks[fill - 8 * r < 8 ? fill - 8 * r : 8]);
+	  wattroff(win, my_color_pairs[0]);
+
+	  // the peak only shows in the rows left empty by the bar
+	  r = peak / 8;
+	  if(peak > fill && r < rows && r >= (fill + 7) / 8)
+		{
+		  wattron(win, my_color_pairs[2]);
+		  mvwaddstr(win, rows - 1 - r, 2 * b, "▔");
+		  wattroff(win, my_color_pairs[2]);
+		}
+	}
+}
+
+/* a braille cell is 2 x 4 dots, the bit of each of them, and
+   the utf-8 of all the 256 cells worked out once */
+static const unsigned char braille_dot[4][2] =
+  {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+static char braille[256][4];
+
+static void
+braille_setup(void)
+{
+  int i;
 
-	  wattron(win, my_color_pairs[2]);
-	  for(i = 0; i < max; i++)
-		wprintw(win, "%c", trail[j]);
-	  wattroff(win, my_color_pairs[2]);	  
-	  j = (j + 1) % 4;
+  for(i = 0; i < 256; i++) // U+2800 + i
+	{
+	  braille[i][0] = 0xE2;
+	  braille[i][1] = 0xA0 | i >> 6;
+	  braille[i][2] = 0x80 | (i & 0x3F);
+	  braille[i][3] = '\0';
 	}
-  else
+}
+
+/* the wave in braille dots, 4 a row. it starts where the mono
+   mix crosses zero upwards in the first half of the frames, so
+   a steady tone stands still, and dots of neighbour columns are
+   joined vertically into a trace */
+void
+draw_scope(float *buf, int frames)
+{
+  WINDOW *win = specific_win(VISUALIZER);
+  const int rows = win->_maxy + 1, cols = win->_maxx + 1;
+  const int dots_y = 4 * rows, dots_x = 2 * cols, span = frames / 2;
+  unsigned char cell[rows * cols];
+  int t, x, y, last = -1, from, to;
+  float s;
+
+  for(t = 1; t < span; t++)
+	if(buf[2 * t - 2] + buf[2 * t - 1] < 0 && buf[2 * t] + buf[2 * t + 1] >= 0)
+	  break;
+  if(t == span)
+	t = 0;
+
+  memset(cell, 0, sizeof(cell));
+  for(x = 0; x < dots_x; x++)
 	{
-	  wattron(win, my_color_pairs[0]);
-	  for(i = 0; i < bars; i++)
-		wprintw(win, "|");
-	  wattroff(win, my_color_pairs[0]);  
-	  wmove(win, 0, max);
-	  color_print(win, 3, "+");
+	  s = .5f * (buf[2 * (t + x * span / dots_x)]
+				 + buf[2 * (t + x * span / dots_x) + 1]);
+	  y = (1.f - s) * .5f * (dots_y - 1) + .5f;
+	  y = y < 0 ? 0 : y >= dots_y ? dots_y - 1 : y;
+
+	  from = last < 0 || last == y ? y : last < y ? last + 1 : last - 1;
+	  to = y;
+	  if(from > to)
+		from ^= to, to ^= from, from ^= to;
+	  for(; from <= to; from++)
+		cell[from / 4 * cols + x / 2] |= braille_dot[from % 4][x % 2];
+
+	  last = y;
 	}
 
-  mvwprintw(win, 0, win->_maxx, "_");
+  wattron(win, my_color_pairs[5]);
+  for(y = 0; y < rows; y++)
+	for(x = 0; x < cols; x++)
+	  if(cell[y * cols + x])
+		mvwaddstr(win, y, x, braille[cell[y * cols + x]]);
+  wattroff(win, my_color_pairs[5]);
 }
 
+/* a column of dots a frame, the bands from the top (highest)
+   down. a braille cell dithers its 8 dots by the ordered matrix
+   below, so a band shows 9 shades in a cell. the window is not
+   erased: only the cell column being swept, and the gap ahead
+   of it, are written, whatever the size of the window */
 void
-draw_sound_wave(int16_t *buf)
+draw_spectrogram(float *buf, float dt)
 {
-  int i;
-  double energy = .0, scope = 30.;
-  const int size = BUFFER_SIZE;
-
-  const int width = wchain[VISUALIZER].win->_maxx - 1;
-  
-  for(i = 0; i < size; i++)
-	energy += buf[i] * buf[i];
-	/* if(energy < buf[i] * buf[i]) */
-	/*   energy = buf[i] * buf[i]; */
-
-  /** filter the sound energy **/
-  energy = pow(sqrt(energy / size), 1. / 3.);
-  
-  int bars = energy * width / scope;
-
-  static int last_bars = 0, max = 0;
-  const int brake = 1;
-
-  if(bars - last_bars > brake)
-	bars -= brake;
-  else
-	bars = last_bars - brake;
-
-  last_bars = bars;
-  
-  if(max < bars || max > bars + 10)
-	max = bars;
-  if(bars < 2)
-	max = bars;
-
-  /* it seems that the mpd fifo a little percivably
-	 forward than the sound card rendering, I use
-	 cache to synchronize them */
-#define DELAY 15
-  static int bcache[DELAY], mcache[DELAY], id = 0;
-  bcache[id] = bars, mcache[id] = max;
-  id = (id + 1) % DELAY;
-  print_uv_meter(bcache[id], mcache[id]);
-  
-  //print_uv_meter(bars, max);
+  static const float dither[4][2] =
+	{{0.5f, 4.5f}, {6.5f, 2.5f}, {1.5f, 5.5f}, {7.5f, 3.5f}};
+  WINDOW *win = wchain[VISUALIZER].win;
+  struct Spectrum *sp = visualizer->spectrum;
+  int rows = win->_maxy + 1, cols = win->_maxx + 1;
+  int x, side, d, r;
+
+  if(rows > SPECTROGRAM_MAX_ROWS)
+	rows = SPECTROGRAM_MAX_ROWS;
+
+  if(4 * rows != sp->nbands || visualizer->rate != sp->rate)
+	spectrum_set_bands(sp, 4 * rows, visualizer->rate);
+
+  spectrum_analyze(sp, buf, dt);
+
+  if(visualizer->sweep >= 2 * cols)
+	visualizer->sweep = 0;
+
+  x = visualizer->sweep / 2;
+  side = visualizer->sweep % 2;
+  if(side == 0)
+	memset(visualizer->sweep_cells, 0, sizeof(visualizer->sweep_cells));
+
+  for(d = 0; d < 4 * rows; d++)
+	if(sp->level[4 * rows - 1 - d] * 8 > dither[d % 4][side])
+	  visualizer->sweep_cells[d / 4] |= braille_dot[d % 4][side];
+
+  wattron(win, my_color_pairs[4]);
+  for(r = 0; r < rows; r++)
+	mvwaddstr(win, r, x, braille[visualizer->sweep_cells[r]]);
+  wattroff(win, my_color_pairs[4]);
+
+  if(side == 0) // the gap ahead marks where the sweep is
+	for(r = 0; r < rows; r++)
+	  mvwaddstr(win, r, (x + 1) % cols, " ");
+
+  visualizer->sweep++;
 }
 
 void
-print_visualizer(void)
+visualizer_next_mode(void)
 {
-  int fifo_id = visualizer->fifo_id;
-  int16_t *buf = visualizer->buff;
+  visualizer->mode = (visualizer->mode + 1) % VIS_MODE_NUM;
+  visualizer->sweep = 0;
+  clean_window(VISUALIZER);
+}
 
-  if (fifo_id < 0)
+/* the visualizer runs at its own frame rate, it asks the main
+   loop to wake up for its next frame rather than keeping the
+   whole interface polling fast. the ballistics go by the time
+   between frames, not their count.
+   the samples shown are the ones being heard, not the latest:
+   what mpd writes to the fifo reaches the speakers only after
+   the output latency, so the window is centred on the sample
+   that entered the fifo that long ago */
+void
+print_visualizer(void)
+{
+  struct SampleRing *ring = &visualizer->ring;
+  float *buf = visualizer->buff;
+  const long long now = get_monotonic_us();
+  const long long period = visualizer->period;
+  const int n = visualizer->mode == VIS_METER ? VIS_WINDOW
+	: visualizer->mode == VIS_SCOPE ? 2 * SCOPE_FRAMES : 2 * SPECTRUM_SIZE;
+  float dt = (now - visualizer->last_frame) / 1e6;
+  unsigned long end, head;
+
+  if(visualizer->fifo_id < 0)
 	return;
 
-  if(read(fifo_id, buf, BUFFER_SIZE *
-		  sizeof(int16_t) / sizeof(char)) < 0)
-	return;
+  if(now < visualizer->next_frame)
+	{
+	  wake_at(visualizer->next_frame);
+	  return;
+	}
+
+  // a late frame doesn't make the next ones come in a burst
+  visualizer->next_frame += period;
+  if(visualizer->next_frame < now)
+	visualizer->next_frame = now + period;
+
+  end = ring_position_at(ring, now - visualizer->latency,
+						 2 * visualizer->rate) + n / 2;
+  head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  end = (end < head ? end : head) & ~1UL; // whole frames
+
+  if(end == visualizer->seen || !ring_read(ring, buf, n, end))
+	{
+	  // nothing played, look again by a slower pace
+	  visualizer->next_frame = now + VIS_IDLE_PERIOD;
+	  wake_at(visualizer->next_frame);
+	  return;
+	}
+
+  visualizer->seen = end;
 
-  static long count = 0;
-  // some delicate calculation of the refresh interval 
-  if(count++ % 4000 == 0)
+  // a long pause would drop everything at once
+  dt = dt < .1f ? dt : .1f;
+
+  switch(visualizer->mode)
 	{
-	  fifo_output_update();
-	  count = 1;
+	case VIS_SPECTRUM:
+	  draw_spectrum(buf, dt); break;
+	case VIS_SCOPE:
+	  draw_scope(buf, n / 2); break;
+	case VIS_SPECTROGRAM:
+	  draw_spectrogram(buf, dt); break;
+	default:
+	  draw_stereo_meter(buf, n / 2, dt);
 	}
-  
-  draw_sound_wave(buf);
-  interval_level = 1;
+
+  visualizer->last_frame = now;
+  wake_at(visualizer->next_frame);
 }
 
 struct Visualizer *visualizer_setup(void)
 {
   struct Visualizer * vis =
 	(struct Visualizer*) malloc(sizeof(struct Visualizer));
-  // TODO add this automatically according to the mpd setting
-  strncpy(vis->fifo_file, "/tmp/mpd.fifo", 64);
+  // what mpd uses unless fifo_discover() finds better
+  strncpy(vis->fifo_file, "/tmp/mpd.fifo", sizeof(vis->fifo_file));
+  vis->rate = 44100;
+  vis->format = SAMPLE_S16;
+  vis->channels = 2;
+
+  vis->fifo_id = -1;
+  vis->ring.data = NULL; // sized by get_fifo_id()
+  vis->ring.size = 0;
+  vis->ring.head = 0;
+  vis->ring.nstamp = 0;
+  vis->latency = config->output_latency_ms * 1000LL;
+  vis->seen = 0;
+  vis->reading = 0;
+
+  vis->mode = VIS_METER;
+  vis->spectrum = spectrum_setup(SPECTRUM_SIZE);
+  vis->meter = meter_setup();
+  vis->sweep = 0;
+  braille_setup();
+  vis->last_frame = vis->next_frame = get_monotonic_us();
+  vis->period = 1000000 / config->visualizer_fps;
 
   return vis;
 }
 
 void visualizer_free(struct Visualizer *vis)
 {
+  if(vis->reading)
+	{
+	  __atomic_store_n(&vis->reading, 0, __ATOMIC_RELEASE);
+	  pthread_join(vis->reader, NULL);
+	}
+
+  if(vis->fifo_id >= 0)
+	close(vis->fifo_id);
+
+  spectrum_free(vis->spectrum);
+  meter_free(vis->meter);
+  free(vis->ring.data);
   free(vis);
 }
@@ -1,21 +1,103 @@
 #include "global.h"
 #include "windows.h"
+#include "dsp.h"
+#include <pthread.h>
+
+#ifndef QOWIEURYTALSKDJFHGZMX
+#define QOWIEURYTALSKDJFHGZMX
+
+#define RING_MIN_SIZE 65536 // stereo samples, a power of two
+#define RING_MAX_SIZE (1 << 22) // 16MB, a longer latency is cut down
+#define RING_SLACK 16384 // the widest window and a read of the fifo
+#define RING_STAMPS 8
+#define VIS_WINDOW 1024 // samples taken for one frame
+#define VIS_IDLE_PERIOD 200000 // us between looks while nothing plays
+#define SCOPE_FRAMES 1024 // half to find a trigger in, half shown
+#define SPECTROGRAM_MAX_ROWS 32 // 4 bands a row
+
+// what the VISUALIZER window shows, cycled by 'V'
+enum vis_mode
+  {
+	VIS_METER,
+	VIS_SPECTRUM,
+	VIS_SCOPE,
+	VIS_SPECTROGRAM,
+	VIS_MODE_NUM
+  };
+
+// when the sample at pos entered the fifo
+struct SampleStamp
+{
+  unsigned long pos;
+  long long us;
+};
+
+/* single producer (the fifo reader thread), single consumer
+ * (the renderer). only the producer moves head, the consumer
+ * just copies whatever lies behind it, so neither ever waits */
+struct SampleRing
+{
+  float *data;
+  int size; // a power of two, see ring_setup()
+  unsigned long head; // samples ever written
+
+  // arrival times, the latest is stamp[nstamp % RING_STAMPS]
+  struct SampleStamp stamp[RING_STAMPS];
+  unsigned long nstamp;
+};
 
 struct Visualizer
 {
   int fifo_id;
-  char fifo_file[64];
-  int16_t buff[BUFFER_SIZE];
+  char fifo_file[512];
+  float buff[2 * SPECTRUM_SIZE];
+
+  // the format mpd writes the fifo in, see fifo_discover()
+  float rate;
+  int format; // enum sample_format
+  int channels;
+
+  int mode; // enum vis_mode
+  struct Spectrum *spectrum;
+  struct Meter *meter;
+
+  /* the spectrogram sweeps a column of dots a frame across the
+   * window, wrapping around rather than scrolling */
+  int sweep; // dot column, two of them a cell
+  unsigned char sweep_cells[SPECTROGRAM_MAX_ROWS]; // dots of the cell column
+  long long last_frame; // us, for the time based ballistics
+  long long next_frame; // us, when the next frame is due
+  long long period; // us between frames
+
+  struct SampleRing ring;
+  unsigned long seen; // end of the samples shown last frame
+  long long latency; // us from the fifo to the speakers
+
+  pthread_t reader;
+  int reading; // 1 while the reader thread should run
 };
 
 struct Visualizer *visualizer;
 
+void ring_write(struct SampleRing *ring, const float *src, int n);
+int  ring_read(struct SampleRing *ring, float *dst, int n,
+			   unsigned long end);
+void ring_stamp(struct SampleRing *ring, unsigned long pos, long long us);
+unsigned long ring_position_at(struct SampleRing *ring, long long us,
+							   float rate);
+
+int  parse_fifo_format(const char *str, float *rate, int *format,
+					   int *channels);
+void fifo_discover(void);
 void get_fifo_id(void);
-int get_fifo_output_id(void);
-void fifo_output_update(void);
-void print_uv_meter(int bars, int max);
-void draw_sound_wave(int16_t *buf);
+void draw_stereo_meter(float *buf, int frames, float dt);
+void draw_scope(float *buf, int frames);
+void draw_spectrogram(float *buf, float dt);
+void draw_spectrum(float *buf, float dt);
+void visualizer_next_mode(void);
 void print_visualizer(void);
 
 struct Visualizer *visualizer_setup(void);
 void visualizer_free(struct Visualizer *vis);
+
+#endif
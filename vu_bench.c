@@ -0,0 +1,98 @@
+/* times the level kernels of dsp.c against the loop the meter
+ * used before them, and checks what they measure.
+ *     make vu_bench && ./vu_bench */
+#include "dsp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#define FRAMES 512 // a frame of the visualizer
+#define ROUNDS 20000
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// what draw_sound_wave() did on the mixed s16 samples
+static double
+old_energy(const int16_t *buf, int size)
+{
+  double energy = .0;
+  int i;
+
+  for(i = 0; i < size; i++)
+	energy += buf[i] * buf[i];
+
+  return pow(sqrt(energy / size), 1. / 3.);
+}
+
+int
+main(void)
+{
+  static int16_t s16[2 * FRAMES];
+  static float frames[2 * FRAMES];
+  struct Meter *m = meter_setup();
+  struct Levels lv;
+  volatile double sink = 0;
+  double t;
+  int i;
+
+  /* a full scale sine at a quarter of the rate, 45 degrees off,
+	 every sample is at 0.707 while the wave peaks at 1 */
+  for(i = 0; i < FRAMES; i++)
+	{
+	  frames[2 * i] = sinf(M_PI / 2 * i + M_PI / 4);
+	  frames[2 * i + 1] = .5f * frames[2 * i];
+	  s16[2 * i] = frames[2 * i] * 32767;
+	  s16[2 * i + 1] = frames[2 * i + 1] * 32767;
+	}
+
+  t = now();
+  for(i = 0; i < ROUNDS; i++)
+	sink += old_energy(s16, 2 * FRAMES);
+  printf("%-26s %8.3f us\n", "old scalar energy",
+		 (now() - t) / ROUNDS * 1e6);
+
+  t = now();
+  for(i = 0; i < ROUNDS; i++)
+	{
+	  levels_scalar(frames, FRAMES, &lv);
+	  sink += lv.rms[0];
+	}
+  printf("%-26s %8.3f us\n", "scalar rms + peak",
+		 (now() - t) / ROUNDS * 1e6);
+
+  t = now();
+  for(i = 0; i < ROUNDS; i++)
+	{
+	  stereo_levels(m, frames, FRAMES, &lv);
+	  sink += lv.rms[0];
+	}
+  printf("%-26s %8.3f us\n", "kernel rms + peak",
+		 (now() - t) / ROUNDS * 1e6);
+
+  t = now();
+  for(i = 0; i < ROUNDS; i++)
+	{
+	  meter_measure(m, frames, FRAMES, &lv);
+	  sink += lv.rms[0];
+	}
+  printf("%-26s %8.3f us\n", "kernel rms + true peak",
+		 (now() - t) / ROUNDS * 1e6);
+
+  printf("\n%-8s %10s %10s %10s\n", "", "rms", "peak", "true peak");
+  for(i = 0; i < 2; i++)
+	printf("%-8s %7.2f dB %7.2f dB %7.2f dB\n", i ? "right" : "left",
+		   lin_to_db(lv.rms[i]), lin_to_db(lv.peak[i]),
+		   lin_to_db(lv.true_peak[i]));
+  printf("expected %7.2f dB %7.2f dB %7.2f dB (left)\n",
+		 20 * log10(M_SQRT1_2), 20 * log10(M_SQRT1_2), 0.);
+
+  meter_free(m);
+  return 0;
+}
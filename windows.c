@@ -5,8 +5,11 @@
 #include "songs.h"
 #include "directory.h"
 #include "playlists.h"
+#include "browser.h"
 #include "visualizer.h"
 #include "keyboards.h"
+#include "inputbox.h"
+#include "render.h"
 
 WINDOW*
 specific_win(int win_id)
@@ -32,7 +35,7 @@ void
 clean_window(int id)
 {
   werase(wchain[id].win);
-  wrefresh(wchain[id].win);
+  window_refresh(wchain[id].win);
 }
 
 void
@@ -42,8 +45,10 @@ clean_screen(void)
   for(i = 0; i < being_mode->size; i++)
 	{
 	  werase(being_mode->wins[i]->win);
-	  wrefresh(being_mode->wins[i]->win);
+	  window_stage(being_mode->wins[i]->win);
 	}
+
+  window_commit();
 }
 
 void
@@ -84,69 +89,76 @@ print_list_item(WINDOW *win, int line, int color, int id,
   wattroff(win, my_color_pairs[color - 1]);
 }
 
-void popup_simple_dialog(const char *message)
+/* lay out a row by the compiled template, fields are indexed
+   by enum format_field, the texts are cut to their columns
+   right here so the stored ones never need to be. the measured
+   ones are cut through their boundaries in pool */
+void
+print_format_row(WINDOW *win, int line, int color,
+				 struct RowFormat *fmt, const struct FieldText *fields,
+				 const struct TextPool *pool)
 {
-  // first do some measurements
-  int width = strlen(message) + 6;
-  width = width > 70 ? 70 : width;
-  int height = 5;
-  int x = stdscr->_maxx / 2 - width / 2;
-  int y = stdscr->_maxy / 2 - height / 2;
+  const int width = win->_maxx;
+  const struct FieldText *field;
+  struct FormatOp *op;
+  char buff[512];
+  int i, cols, x = 0;
 
-  WINDOW *dialog = newwin(height, width, y, x);
-  wmove(dialog, 2, 3);
-  wprintw(dialog, message); // hope the prompt won't be too long
-  wborder(dialog, 0, 0, 0, 0, 0, 0, 0, 0);
+  row_format_layout(fmt, width);
 
-  wrefresh(dialog);
+  if(color > 0)
+	wattron(win, my_color_pairs[color - 1]);
 
-  sleep(1); // stay awhile
+  mvwprintw(win, line, 0, "%*c", width, ' ');
 
-  // destroy the window
-  werase(dialog);
-  wrefresh(dialog);
-  delwin(dialog);
+  for(i = 0, op = fmt->ops; i < fmt->size && x < width; i++, op++)
+	{
+	  cols = op->cols < width - x ? op->cols : width - x;
+	  field = fields + op->field;
+
+	  if(op->field == FIELD_LITERAL)
+		utf8_fit(buff, sizeof(buff), fmt->literals + op->literal, cols);
+	  else if(field->str && field->info)
+		text_fit(buff, sizeof(buff), field->str, field->info, pool, cols);
+	  else if(field->str)
+		utf8_fit(buff, sizeof(buff), field->str, cols);
+	  else
+		buff[0] = '\0';
+
+	  if(op->cols > 0)
+		mvwprintw(win, line, x, "%s", buff);
+
+	  x += op->cols;
+	}
 
-  signal_all_wins();
+  if(color > 0)
+	wattroff(win, my_color_pairs[color - 1]);
 }
 
-char* popup_input_dialog(const char *prompt)
+void popup_simple_dialog(const char *message)
 {
-  static char ret[512];
-  
   // first do some measurements
-  int width = stdscr->_maxx / 2;
-  int height = 8;
+  int width = strlen(message) + 6;
+  width = width > 70 ? 70 : width;
+  int height = 5;
   int x = stdscr->_maxx / 2 - width / 2;
   int y = stdscr->_maxy / 2 - height / 2;
 
   WINDOW *dialog = newwin(height, width, y, x);
-  wmove(dialog, 2, 2);
-  wprintw(dialog, prompt); // hope the prompt won't be too long
-  wmove(dialog, 4, 4);
+  wmove(dialog, 2, 3);
+  wprintw(dialog, message); // hope the prompt won't be too long
   wborder(dialog, 0, 0, 0, 0, 0, 0, 0, 0);
 
-  wrefresh(dialog);
-  
-  notimeout(dialog, TRUE); // block the wgetch()
-  echo();
-  curs_set(1);
-  
-  if(wscanw(dialog, "%128[^\n]%*c", ret) == ERR)
-	if(*ret)
-	  ErrorAndExit("char array overflows.");
-	
-  noecho();
-  curs_set(0);
+  window_refresh(dialog);
+
+  sleep(1); // stay awhile
 
   // destroy the window
   werase(dialog);
-  wrefresh(dialog);
+  window_refresh(dialog);
   delwin(dialog);
 
   signal_all_wins();
-
-  return ret;
 }
 
 /* return 1(yes) or 0(no) */
@@ -195,13 +207,13 @@ int popup_confirm_dialog(const char *prompt, int dflt)
 	color_print(dialog, ret ? 2 : 0, "YES ");
 	wmove(dialog, 4, width - offset - 3);
 	color_print(dialog, ret ? 0 : 2, " NO ");
-	wrefresh(dialog);
+	window_refresh(dialog);
 	
   }while(!out && (key = wgetch(dialog)) != '\n');
 
   // destroy the window
   werase(dialog);
-  wrefresh(dialog);
+  window_refresh(dialog);
   delwin(dialog);
 
   signal_all_wins();
@@ -216,7 +228,7 @@ void debug(const char *debug_info)
   if(debug_info)
 	{
 	  wprintw(win, debug_info);
-	  wrefresh(win);
+	  window_refresh(win);
 	}
 }
 
@@ -226,14 +238,14 @@ void debug_static(const char *debug_info)
   WINDOW *win = specific_win(DEBUG_INFO);
   wprintw(win, "[%i] ", t++);
   wprintw(win, debug_info);
-  wrefresh(win);
+  window_refresh(win);
 }
 
 void debug_int(const int num)
 {
   WINDOW *win = specific_win(DEBUG_INFO);
   wprintw(win, "%d", num);
-  wrefresh(win);
+  window_refresh(win);
 }
 
 void debug_int_static(const int num)
@@ -242,7 +254,7 @@ void debug_int_static(const int num)
   WINDOW *win = specific_win(DEBUG_INFO);
   wprintw(win, "[%i] ", t++);
   wprintw(win, "%d", num);
-  wrefresh(win);
+  window_refresh(win);
 }
 
 /* draw border for all window, this is for debugging
@@ -254,7 +266,7 @@ void outline_all_windows(void)
 	{
 	  werase(wchain[i].win);
 	  wborder(wchain[i].win, 0, 0, 0, 0, 0, 0, 0, 0);
-	  wrefresh(wchain[i].win);
+	  window_refresh(wchain[i].win);
 	}
 
   getchar();
@@ -280,7 +292,10 @@ wchain_init(void)
 	  &playlist_redraw_screen,   // PLAYLIST
 	  &playlist_display_icon,    // PLAYICON
 	  &playlist_helper,          // PLAYHELPER
+	  &browser_redraw_screen,    // LIBRARY
+	  &browser_helper,           // LIBHELPER
 	  &search_prompt,			 // SEARCH_INPUT
+	  &inputbox_redraw,			 // INPUT_BOX
 	  NULL						 // DEBUG_INFO  
 	};
 
@@ -298,17 +313,30 @@ wchain_init(void)
 	  &directory_update_checking,    // DIRECTORY
 	  NULL,                          // DIRHICON
 	  NULL,                          // DIRHELPER
-	  &playlist_update_checking,     // PLAYLIST
+	  NULL,                          // PLAYLIST
 	  NULL,                          // PLAYICON
 	  NULL,                          // PLAYHELPER
+	  &browser_update_checking,      // LIBRARY
+	  NULL,                          // LIBHELPER
 	  NULL,			                 // SEARCH_INPUT
+	  NULL,			                 // INPUT_BOX
 	  NULL						     // DEBUG_INFO  
 	};
   
+  const char *names[WIN_NUM] =
+	{
+	  "BASIC_INFO", "EXTRA_INFO", "VERBOSE_PROC_BAR", "VISUALIZER",
+	  "HELPER", "SIMPLE_PROC_BAR", "SLIST_UP_STATE_BAR", "SONGLIST",
+	  "SLIST_DOWN_STATE_BAR", "DIRECTORY", "DIRICON", "DIRHELPER",
+	  "PLAYLIST", "PLAYICON", "PLAYHELPER", "LIBRARY", "LIBHELPER",
+	  "SEARCH_INPUT", "INPUT_BOX", "DEBUG_INFO"
+	};
+  
   int i;
   wchain = (struct WindowUnit*)malloc(WIN_NUM * sizeof(struct WindowUnit));
   for(i = 0; i < WIN_NUM; i++)
 	{
+	  wchain[i].name = names[i];
 	  wchain[i].win = newwin(0, 0, 0, 0);// we're gonna change soon
 	  wchain[i].redraw_routine = redraw_func[i];
 	  wchain[i].update_checking = checking_func[i];
@@ -325,6 +353,7 @@ wchain_init(void)
   wchain[HELPER].visible = 0;
   wchain[VISUALIZER].visible = 0;
   wchain[SEARCH_INPUT].visible = 0;
+  wchain[INPUT_BOX].visible = 0;
   
   wchain_size_update();
 }
@@ -341,12 +370,14 @@ wchain_size_update(void)
   else
 	old_height = height, old_width = width;
 
+  render_resize(height, width);
+
   int wparam[WIN_NUM][4] =
 	{
 	  {2, width, 0, 0},             // BASIC_INFO
 	  {1, width - 47, 2, 46},       // EXTRA_INFO
 	  {1, 42, 2, 0},				// VERBOSE_PROC_BAR
-	  {1, 72, 4, 0},				// VISUALIZER
+	  {9, 72, 4, 0},				// VISUALIZER
 	  {9, width, 5, 0},				// HELPER
 	  {1, 29, 4, 43},				// SIMPLE_PROC_BAR
 	  {1, 15, 4, 8},				// SLIST_UP_STATE_BAR
@@ -354,11 +385,14 @@ wchain_size_update(void)
 	  {1, width, height - 3, 0},	// SLIST_DOWN_STATE_BAR
 	  {height - 8, 32, 6, 41},	    // DIRECTORY
 	  {6, 20, 4, 11},               // DIRICON
-	  {10, 30, 12, 2},              // DIRHELPER
+	  {13, 30, 10, 2},              // DIRHELPER
 	  {9, 31, 5, 2},	            // PLAYLIST
 	  {5, 15, 16, 10},	            // PLAYICON
 	  {15, 29, 6, 43},              // PLAYHELPER
+	  {height - 8, 38, 6, 35},      // LIBRARY
+	  {16, 30, 5, 2},               // LIBHELPER
 	  {1, width, height - 1, 0},	// SEARCH_INPUT
+	  {8, width / 2, height / 2 - 4, width / 4}, // INPUT_BOX
 	  {1, width, height - 2, 0}		// DEBUG_INFO       
 	}; 
 
@@ -408,18 +442,33 @@ void color_init(void)
 void
 screen_redraw(void)
 {
-  int i;
+  int i, cells;
+  long long start;
   struct WindowUnit **wunit = being_mode->wins;
   for(i = 0; i < being_mode->size; i++)
 	{
 	  if(wunit[i]->visible && wunit[i]->redraw_signal
 		 && wunit[i]->redraw_routine)
 		{
+		  start = get_monotonic_us();
 		  wunit[i]->redraw_routine();
-		  wrefresh(wunit[i]->win);
+		  cells = window_stage(wunit[i]->win);
+		  render_account(wunit[i] - wchain, start, cells);
 		}
 	  wunit[i]->redraw_signal = wunit[i]->flash;
 	}
+
+  /* the input box belongs to no mode, it floats over whatever
+	 mode is being used and has to be put back on top every
+	 time the windows beneath it are redrawn */
+  if(wchain[INPUT_BOX].visible)
+	{
+	  inputbox_redraw();
+	  touchwin(wchain[INPUT_BOX].win);
+	  window_stage(wchain[INPUT_BOX].win);
+	}
+
+  window_commit();
 }
 
 void
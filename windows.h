@@ -1,4 +1,5 @@
 #include "global.h"
+#include "format.h"
 
 #ifndef F98IQJFNASKFJSAODI
 #define F98IQJFNASKFJSAODI
@@ -24,13 +25,17 @@ enum window_id
 	PLAYLIST,                // window list all playlists
 	PLAYICON,                // icon window for playlist
 	PLAYHELPER,              // playlist instruction 
+	LIBRARY,                 // artists, albums or songs of the library
+	LIBHELPER,               // library instruction
 	SEARCH_INPUT,			 // search prompt area
+	INPUT_BOX,               // text input dialog, floats over all modes
 	DEBUG_INFO,				 // for debug perpuse only
 	WIN_NUM                  // number of windows
   };
 
 struct WindowUnit
 {
+  const char *name;
   int visible;
   // if visible and 1 means this window redraw alway
   // every time, its redraw_signal always be 1;
@@ -65,9 +70,11 @@ void being_mode_update(struct WinMode *wmode);
 void color_print(WINDOW *win, int color_scheme, const char *str);
 void print_list_item(WINDOW *win, int line, int color, int id,
 					 char *ltext, char *rtext);
+void print_format_row(WINDOW *win, int line, int color,
+					  struct RowFormat *fmt, const struct FieldText *fields,
+					  const struct TextPool *pool);
 
 void popup_simple_dialog(const char *message);
-char* popup_input_dialog(const char *prompt);
 int popup_confirm_dialog(const char *prompt, int dflt);
 
 void wchain_init(void);